@@ -3,23 +3,104 @@
 
 #include "layers.hpp"
 
+#include <functional>
+
 namespace SplineNetLib {
 
-//network class
-class nn{
+//settings of nn::fit
+template<typename T>
+struct fit_options_t {
+    size_t epochs = 10;
+    size_t batch_size = 32;
+    bool shuffle = true; //shuffle the samples every epoch
+    bool normalize = false; //normalize argument of the forward passes
+    size_t patience = 0; //stop after patience epochs without the loss improving by more than min_delta (0 = never stop early)
+    T min_delta = T(0);
+    unsigned int seed = 0; //seed of the shuffle
+    std::function<void(size_t epoch, T loss)> on_epoch; //called after every epoch if set
+};
+
+//what nn::fit did
+template<typename T>
+struct fit_result_t {
+    std::vector<T> epoch_loss; //mean squared error of every epoch (over all samples and outputs, measured during the epoch)
+    bool stopped_early = false;
+};
+
+template<typename T> class compiled_nn_t;
+
+//network class, T is the scalar type (float and double are instantiated in the library)
+template<typename T>
+class nn_t{
+    private:
+    std::vector<T> workspace; //ping pong buffers for forward_into (sized on first use)
+    
+    //batch inputs of the layers from the last batched forward with training set (activations[i] = input of layer i)
+    //only every checkpoint_stride-th entry is kept if all of them dont fit into activation_budget
+    std::vector<std::vector<std::vector<T>>> activations;
+    size_t checkpoint_stride = 1;
+    bool activations_normalized = false;
+    
+    //smallest stride so the kept layer inputs of a batch of batch_size fit into activation_budget
+    size_t choose_checkpoint_stride(size_t batch_size) const;
     
     public:
     //vector to store layers
-    std::vector<layer> layers;
-    //constructor to create network from scratch
-    nn(int num_layers,std::vector<unsigned int> in,std::vector<unsigned int> out,std::vector<unsigned int> detail,std::vector<double> max);
+    std::vector<layer_t<T>> layers;
+    bool training = false; //if true the batched forward keeps the layer inputs for the batched backward
+    size_t activation_budget = 0; //max bytes of kept layer inputs (0 = no limit), above it inputs are recomputed from checkpoints in backward
+    //constructor to create network from scratch (kind and boundary are used for all layers)
+    nn_t(int num_layers,std::vector<unsigned int> in,std::vector<unsigned int> out,std::vector<unsigned int> detail,std::vector<T> max,
+         spline_kind kind = spline_kind::natural, boundary_policy boundary = boundary_policy::error);
     //forward pass (uses parameters for layer.forward)
-    std::vector<double> forward(std::vector<double> x,bool normalize);
+    std::vector<T> forward(std::vector<T> x,bool normalize);
+    //batched forward pass (every layer splits the batch across default_pool(), see layer::grain)
+    //with training set the inputs of the layers are kept for the batched backward
+    std::vector<std::vector<T>> forward(const std::vector<std::vector<T>> &x, bool normalize);
+    //trains on the samples x with targets y (mean squared error) using the batched forward/backward
+    //throws std::invalid_argument if x and y dont match, are empty or batch_size is 0
+    fit_result_t<T> fit(const std::vector<std::vector<T>> &x, const std::vector<std::vector<T>> &y, const fit_options_t<T> &options);
+    //fit with default options exept epochs, batch_size and shuffle
+    fit_result_t<T> fit(const std::vector<std::vector<T>> &x, const std::vector<std::vector<T>> &y, size_t epochs, size_t batch_size, bool shuffle = true);
+    //allocation free forward (after the first call), x.size() == first layers input size, out.size() == last layers output size
+    //does not set last_output of the layers so backward needs forward
+    void forward_into(std::span<const T> x, std::span<T> out, bool normalize);
+    //same as above but with a caller provided workspace of at least workspace_size() elements (no member state is touched)
+    void forward_into(std::span<const T> x, std::span<T> out, bool normalize, std::span<T> workspace) const;
+    //number of elements forward_into needs as workspace (2 x largest layer output)
+    size_t workspace_size() const;
+    //non blocking forward on default_pool() (uses the const forward_into with its own workspace, so several calls can run
+    //at the same time). the network must not be changed or destroyed until the result is there, dont wait for the
+    //result inside a pool task
+    //done(output, nullptr) or done({}, exception) is called on the worker thread, it should not throw (an exception of done
+    //is printed and dropped)
+    void forward_async(std::vector<T> x, bool normalize, std::function<void(std::vector<T>, std::exception_ptr)> done) const;
+    std::future<std::vector<T>> forward_async(std::vector<T> x, bool normalize) const;
+    //batched version, the samples are split across the pool like the batched forward
+    std::future<std::vector<std::vector<T>>> forward_async(std::vector<std::vector<T>> x, bool normalize) const;
+    //immutable inference copy of the network (see compiled_nn.hpp), normalize is fixed when compiling
+    compiled_nn_t<T> compile(bool normalize) const;
     //backward pass (uses parameters for layer.backward)
-    std::vector<double> backward(std::vector<double> x,std::vector<double> d_y);
+    std::vector<T> backward(std::vector<T> x,std::vector<T> d_y);
+    //batched backward pass, needs a batched forward of x with training set first (throws otherwise)
+    //every layer accumulates the grads of the batch and applies them once (see layer::backward)
+    std::vector<std::vector<T>> backward(const std::vector<std::vector<T>> &x, std::vector<std::vector<T>> d_y);
         
 };
 
+//float and double are compiled into the library
+extern template class nn_t<float>;
+extern template class nn_t<double>;
+
+//default (double precision) name
+using nn = nn_t<double>;
+using fit_options = fit_options_t<double>;
+using fit_result = fit_result_t<double>;
+//single precision name
+using nn_f = nn_t<float>;
+using fit_options_f = fit_options_t<float>;
+using fit_result_f = fit_result_t<float>;
+
 }//namespace
 
 #endif
\ No newline at end of file
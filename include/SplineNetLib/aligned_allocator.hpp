@@ -0,0 +1,57 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef ALIGNED_ALLOCATOR_HPP
+#define ALIGNED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace SplineNetLib {
+
+//allocator that places the first element on an Alignment byte boundary (default = one cache line)
+template<typename T, std::size_t Alignment = 64>
+class aligned_allocator {
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator() noexcept = default;
+
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    bool operator==(const aligned_allocator<U, Alignment>&) const noexcept { return true; }
+
+    template<typename U>
+    bool operator!=(const aligned_allocator<U, Alignment>&) const noexcept { return false; }
+};
+
+//contiguous cache line aligned storage used for spline knots and coefficients
+template<typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+}//namespace
+
+#endif
@@ -0,0 +1,96 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef BATCHER_HPP
+#define BATCHER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "compiled_nn.hpp"
+
+namespace SplineNetLib {
+
+//request queue in front of a compiled network for services with many independent single sample requests
+//submit can be called from any thread, a dispatcher thread collects the waiting requests into micro batches of at most
+//max_batch samples (waiting at most max_wait after the oldest request) and runs them with the batched forward
+template<typename T>
+class inference_batcher_t {
+    private:
+        struct request_t {
+            std::vector<T> x;
+            std::promise<std::vector<T>> result;
+            std::chrono::steady_clock::time_point arrival;
+        };
+
+        const compiled_nn_t<T> net;
+        const size_t max_batch;
+        const std::chrono::microseconds max_wait;
+
+        std::deque<request_t> requests;
+        std::mutex requests_mutex;
+        std::condition_variable requests_cv;
+        bool stopping = false;
+        std::atomic<size_t> batches{0}, samples{0};
+        std::thread dispatcher;
+
+        void dispatch_loop();
+        //runs one micro batch and completes its futures
+        void run_batch(std::vector<request_t> &batch);
+
+    public:
+
+        //compiles source (see nn::compile), throws std::invalid_argument if max_batch is 0
+        inference_batcher_t(const nn_t<T> &source, bool normalize, size_t max_batch = 32,
+                            std::chrono::microseconds max_wait = std::chrono::microseconds(500));
+        //finishes all submitted requests, then stops the dispatcher
+        ~inference_batcher_t();
+
+        inference_batcher_t(const inference_batcher_t&) = delete;
+        inference_batcher_t& operator=(const inference_batcher_t&) = delete;
+
+        //queues one sample, the future gets the output (or the exception of its forward, e.g. out of bounds)
+        //throws std::invalid_argument right away if x doesnt have the input size
+        std::future<std::vector<T>> submit(std::vector<T> x);
+        //submit and wait
+        std::vector<T> forward(std::vector<T> x) {
+            return submit(std::move(x)).get();
+        }
+
+        //number of micro batches and samples run so far (samples / batches is the average batch size)
+        size_t num_batches() const {
+            return batches.load();
+        }
+        size_t num_samples() const {
+            return samples.load();
+        }
+        size_t max_batch_size() const {
+            return max_batch;
+        }
+        std::chrono::microseconds max_wait_time() const {
+            return max_wait;
+        }
+};
+
+extern template class inference_batcher_t<float>;
+extern template class inference_batcher_t<double>;
+
+//default (double precision) name
+using inference_batcher = inference_batcher_t<double>;
+//single precision name
+using inference_batcher_f = inference_batcher_t<float>;
+
+}//namespace
+
+#endif
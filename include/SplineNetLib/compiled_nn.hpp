@@ -0,0 +1,99 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef COMPILED_NN_HPP
+#define COMPILED_NN_HPP
+
+#include "SplineNet.hpp"
+
+namespace SplineNetLib {
+
+//frozen inference version of a network (nn::compile), only the knots and coefficients of all layers are kept in one arena
+//(no grads, last_output, lr or optimizer state). It never changes after construction, so one object can be used by any
+//number of threads at the same time without locks
+template<typename T>
+class compiled_nn_t {
+    private:
+        //per input of a layer: if all splines of the input have the same knots the row is [knots][segment][a,b,c,d][out]
+        //(like layer::packed, one segment search for all outputs), otherwise every spline is [knots][segment][a,b,c,d]
+        struct row_plan {
+            size_t offset;  //start of the row in arena
+            bool shared;
+            T inv_h;        //spline::uniform_inv_h of the shared knots (0 = binary search)
+        };
+        struct layer_plan {
+            unsigned int in_size, out_size, points;
+            boundary_policy boundary;
+            bool normalize; //divide the inputs of the next layer by the maximum of this layers output
+            size_t first_row; //index of input 0 in rows
+        };
+
+        aligned_vector<T> arena;
+        std::vector<row_plan> rows;
+        std::vector<layer_plan> layers;
+        size_t max_width = 0; //largest layer output
+        bool normalized = false;
+
+        //adds the outputs of all splines of input row r of layer l at x to out
+        void add_row(const layer_plan &l, const row_plan &r, T x, T* out) const;
+
+    public:
+
+        size_t grain = 16; //samples per task of the batched forward
+
+        //copies the splines of all layers of source, normalize is applied after every layer exept the last one like
+        //nn::forward(x, true). throws std::invalid_argument if source has no layers
+        compiled_nn_t(const nn_t<T> &source, bool normalize);
+
+        //forward of the whole network with the ping pong buffers in workspace (at least workspace_size() values)
+        //throws std::invalid_argument if a size is wrong
+        void forward_into(std::span<const T> x, std::span<T> out, std::span<T> workspace) const;
+        //same as above with a thread local workspace (no allocations after the first call of a thread)
+        void forward_into(std::span<const T> x, std::span<T> out) const;
+        std::vector<T> forward(const std::vector<T> &x) const;
+        //forward with batches (chunks of grain samples run in parallel on default_pool())
+        std::vector<std::vector<T>> forward(const std::vector<std::vector<T>> &x) const;
+        //forward as a task on default_pool() (the compiled network has to live until the future is ready)
+        std::future<std::vector<T>> forward_async(std::vector<T> x) const {
+            return default_pool().submit([this, x = std::move(x)]() { return forward(x); });
+        }
+
+        size_t workspace_size() const {
+            return 2 * max_width;
+        }
+        //bytes of the coefficient arena
+        size_t arena_bytes() const {
+            return arena.size() * sizeof(T);
+        }
+        bool normalizes() const {
+            return normalized;
+        }
+        size_t num_layers() const {
+            return layers.size();
+        }
+        unsigned int input_size() const {
+            return layers.front().in_size;
+        }
+        unsigned int output_size() const {
+            return layers.back().out_size;
+        }
+};
+
+extern template class compiled_nn_t<float>;
+extern template class compiled_nn_t<double>;
+
+//default (double precision) name
+using compiled_nn = compiled_nn_t<double>;
+//single precision name
+using compiled_nn_f = compiled_nn_t<float>;
+
+}//namespace
+
+#endif
@@ -0,0 +1,222 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef FIXED_LAYER_HPP
+#define FIXED_LAYER_HPP
+
+#include <array>
+#include <utility>
+#include "layers.hpp"
+
+namespace SplineNetLib {
+
+//spline with Detail + 2 knots known at compile time (for deployment of trained splines)
+//std::array storage without heap allocations, the segment search and the interpolation have a fixed trip count so the
+//compiler unrolls them, T is the scalar type
+template<typename T, size_t Detail>
+class fixed_spline_t {
+    public:
+
+        static constexpr size_t num_points = Detail + 2;
+        static constexpr size_t num_segments = Detail + 1;
+
+    private:
+
+        std::array<T, num_points> knot_x{}, knot_y{};
+        std::array<T, num_segments * 4> coeffs{}; //interleaved a,b,c,d per segment like spline
+        spline_kind kind = spline_kind::natural;
+        boundary_policy boundary = boundary_policy::error;
+
+        //segment i covers (x_i, x_i+1], so the segment is the number of inner knots below x (no branches, nan -> 0)
+        template<size_t... K>
+        size_t find_segment(T x, std::index_sequence<K...>) const {
+            return (size_t(0) + ... + (size_t)(x > knot_x[K + 1]));
+        }
+
+    public:
+
+        constexpr fixed_spline_t() = default;
+        //copies the knots and coefficients of source, throws std::invalid_argument if source doesnt have num_points knots
+        explicit fixed_spline_t(const spline_t<T> &source) : kind(source.get_kind()), boundary(source.get_boundary()) {
+            std::vector<std::vector<T>> points = source.get_points(), params = source.get_params();
+            if (points.size() != num_points) {
+                throw std::invalid_argument("fixed_spline: source spline has a different number of points than Detail + 2.");
+            }
+            for (size_t i = 0; i < num_points; i++) {
+                knot_x[i] = points[i][0];
+                knot_y[i] = points[i][1];
+            }
+            for (size_t i = 0; i < num_segments; i++) {
+                for (size_t k = 0; k < 4; k++) {
+                    coeffs[i * 4 + k] = params[i][k];
+                }
+            }
+        }
+
+        //same as spline::forward (including the boundary policy)
+        T forward(T x) const {
+            T xb = x;
+            if (boundary == boundary_policy::error) {
+                if (!(x <= knot_x[num_points - 1])) {
+                    print_err("x not in range of spline bounds. bounds : [", knot_x[0], ",", knot_x[num_points - 1], "]");
+                    throw std::runtime_error("x out of bounds");
+                }
+            } else {
+                xb = std::min(knot_x[num_points - 1], std::max(knot_x[0], x));
+            }
+            size_t i = find_segment(xb, std::make_index_sequence<num_segments - 1>());
+            const T* p = &coeffs[i * 4];
+            T u = xb - knot_x[i];
+            T y = p[0] + u * (p[1] + u * (p[2] + u * p[3]));
+            if (boundary == boundary_policy::extrapolate) {
+                y += (p[1] + u * (T(2) * p[2] + T(3) * u * p[3])) * (x - xb);
+            }
+            return y;
+        }
+
+        //recomputes the coefficients from the knots (same result as spline::interpolation)
+        void interpolation() {
+            const std::array<T, num_points> &x = knot_x, &y = knot_y;
+            if (kind == spline_kind::bspline) {
+                for (size_t i = 0; i < num_segments; i++) {
+                    T p0 = y[(i > 0) ? i - 1 : 0], p1 = y[i], p2 = y[i + 1], p3 = y[std::min(i + 2, num_points - 1)];
+                    T inv_h = T(1) / (x[i + 1] - x[i]);
+                    T* p = &coeffs[i * 4];
+                    p[0] = (p0 + T(4) * p1 + p2) / T(6);
+                    p[1] = (p2 - p0) / T(2) * inv_h;
+                    p[2] = (p0 - T(2) * p1 + p2) / T(2) * inv_h * inv_h;
+                    p[3] = (-p0 + T(3) * p1 - T(3) * p2 + p3) / T(6) * inv_h * inv_h * inv_h;
+                }
+                return;
+            }
+            //natural spline, thomas algorithm on the stack
+            std::array<T, num_segments> h{};
+            std::array<T, num_points> mu{}, z{};
+            for (size_t i = 0; i < num_segments; i++) {
+                h[i] = x[i + 1] - x[i];
+            }
+            for (size_t i = 1; i < num_segments; i++) {
+                T l = T(2) * (x[i + 1] - x[i - 1]) - h[i - 1] * mu[i - 1];
+                mu[i] = h[i] / l;
+                T alpha = T(3) * (y[i + 1] - y[i]) / h[i] - T(3) * (y[i] - y[i - 1]) / h[i - 1];
+                z[i] = (alpha - h[i - 1] * z[i - 1]) / l;
+            }
+            T c_next = T(0);
+            for (size_t j = num_segments; j-- > 0;) {
+                T* p = &coeffs[j * 4];
+                p[2] = z[j] - mu[j] * c_next;
+                p[1] = (y[j + 1] - y[j]) / h[j] - h[j] * (c_next + T(2) * p[2]) / T(3);
+                p[3] = (c_next - p[2]) / (T(3) * h[j]);
+                p[0] = y[j];
+                c_next = p[2];
+            }
+        }
+
+        void set_boundary(boundary_policy policy) {
+            boundary = policy;
+        }
+        boundary_policy get_boundary() const {
+            return boundary;
+        }
+        spline_kind get_kind() const {
+            return kind;
+        }
+};
+
+//inference only copy of a layer whose splines all have Detail + 2 knots, the splines are stored in one [in][out] array
+template<typename T, size_t Detail>
+class fixed_layer_t {
+    private:
+
+        unsigned int in_size = 0, out_size = 0;
+        std::vector<fixed_spline_t<T, Detail>> splines; //[in][out]
+
+    public:
+
+        size_t grain = 16; //samples per task of the batched forward
+
+        //copies the trained splines of source, throws std::invalid_argument if the detail of source isnt Detail
+        explicit fixed_layer_t(const layer_t<T> &source) : in_size(source.in_size), out_size(source.out_size) {
+            if (source.detail != Detail) {
+                throw std::invalid_argument("fixed_layer: the detail of the source layer doesnt match Detail.");
+            }
+            splines.reserve((size_t)in_size * out_size);
+            for (size_t i = 0; i < in_size; i++) {
+                for (size_t j = 0; j < out_size; j++) {
+                    splines.emplace_back(source.l_splines[i][j]);
+                }
+            }
+        }
+
+        //allocation free forward, x.size() == input size, out.size() == output size (throws otherwise)
+        void forward_into(std::span<const T> x, std::span<T> out, bool normalize) const {
+            if (x.size() != in_size || out.size() != out_size) {
+                throw std::invalid_argument("forward_into: x must have the layers input size and out its output size");
+            }
+            std::fill(out.begin(), out.end(), T(0));
+            for (size_t i = 0; i < in_size; i++) {
+                const fixed_spline_t<T, Detail>* row = &splines[i * out_size];
+                for (size_t j = 0; j < out_size; j++) {
+                    out[j] += row[j].forward(x[i]);
+                }
+            }
+            if (normalize) {
+                layer_t<T>::normalize_output(out);
+            }
+        }
+        //same as layer::forward
+        std::vector<T> forward(const std::vector<T> &x, bool normalize) const {
+            std::vector<T> output(out_size);
+            forward_into(x, output, normalize);
+            return output;
+        }
+        //forward with batches (chunks of grain samples run in parallel on default_pool())
+        std::vector<std::vector<T>> forward(const std::vector<std::vector<T>> &x, bool normalize) const {
+            std::vector<std::vector<T>> output(x.size(), std::vector<T>(out_size));
+            default_pool().parallel_for(x.size(), grain, [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; b++) {
+                    forward_into(x[b], output[b], normalize);
+                }
+            });
+            return output;
+        }
+
+        //sets the out of range policy of all splines
+        void set_boundary(boundary_policy policy) {
+            for (fixed_spline_t<T, Detail> &s : splines) {
+                s.set_boundary(policy);
+            }
+        }
+        //spline of input i and output j
+        const fixed_spline_t<T, Detail>& get_spline(size_t i, size_t j) const {
+            return splines[i * out_size + j];
+        }
+        unsigned int input_size() const {
+            return in_size;
+        }
+        unsigned int output_size() const {
+            return out_size;
+        }
+};
+
+//default (double precision) names
+template<size_t Detail>
+using fixed_spline = fixed_spline_t<double, Detail>;
+template<size_t Detail>
+using fixed_layer = fixed_layer_t<double, Detail>;
+//single precision names
+template<size_t Detail>
+using fixed_spline_f = fixed_spline_t<float, Detail>;
+template<size_t Detail>
+using fixed_layer_f = fixed_layer_t<float, Detail>;
+
+}//namespace
+
+#endif
@@ -12,48 +12,206 @@
 #define LAYERS_HPP
 
 #include "splines.hpp"
+#include "thread_pool.hpp"
+#include "optimizers.hpp"
 
 namespace SplineNetLib {
     
+//how layer::step scales the accumulated gradient
+enum class grad_reduction {
+    mean, //gradient / number of accumulated samples
+    sum   //gradient as accumulated
+};
+
 
+template<typename T> class lut_layer_t;
+template<typename T, size_t Detail> class fixed_layer_t;
 
-class layer{
+//layer of in_size x out_size splines, T is the scalar type (float and double are instantiated in the library)
+template<typename T>
+class layer_t{
+    friend class lut_layer_t<T>; //samples the splines when a layer is frozen
+    template<typename U, size_t Detail> friend class fixed_layer_t; //copies the splines into the fixed size form
     private:
         
         
         unsigned int in_size, out_size, detail; //num input params,num output params, num of points in all layerspecific splines - 2
+        spline_kind kind = spline_kind::natural; //kind of all splines in the layer
+        boundary_policy boundary = boundary_policy::error; //out of range policy of all splines in the layer
+        
+        std::vector<std::vector<spline_t<T>>> l_splines;
+        
+        //shared knot kernel: if all splines of input i have the same knots their coefficients are packed like [segment][a,b,c,d][out]
+        //so the segment is found once per input and all outputs are one dense multiply add
+        aligned_vector<T> packed;
+        std::vector<size_t> packed_offset; //start of input i in packed (not_packed if the splines of input i have different knots)
+        static constexpr size_t not_packed = (size_t)-1;
+        std::vector<size_t> grad_offset; //[in*out + 1] start of the grad of spline (i,j) in a flat buffer of all spline grads
+        //below this output size the batched forward evaluates spline by spline (simd over the batch) instead of using packed
+        static constexpr size_t packed_batch_min_outputs = 8;
+        
+        //lets all natural splines with the same knots use one factorization
+        void share_factorizations();
+        //checks which inputs can be packed and sizes packed (knots dont change so this is only needed on construction)
+        void init_packing();
+        //copies the spline coefficients of the inputs [begin, end) into packed (after every change of the coefficients)
+        void pack_rows(size_t begin, size_t end);
+        void pack_coefficients() {
+            pack_rows(0, in_size);
+        }
+        //returns the segment of x for the packed input i and sets u = x - x_segment (of the clamped x) and dx = x - clamped x
+        //(0 exept for extrapolate outside of the knots), throws if x is out of bounds and boundary is error
+        size_t locate_packed(size_t i, T x, T &u, T &dx) const;
+        //adds the outputs of all splines of input i at x to out
+        void forward_row(size_t i, T x, T* out) const;
+        
+        //interpolates all splines that share the factorization f in one vectorized solve
+        static void interpolate_group(const spline_factorization_t<T> &f, const std::vector<spline_t<T>*> &group);
         
-        std::vector<std::vector<spline>> l_splines;
+        //training tape, filled by forward if training is set and consumed by backward (buffers are reused between batches)
+        struct tape_t {
+            size_t batch_size = 0;          //number of recorded samples (0 = no tape)
+            std::vector<T> inputs;          //[b][in] inputs of the recorded forward pass
+            std::vector<uint32_t> segments; //[b][in][out] segment index of every spline
+            std::vector<T> offsets;         //[b][in][out] x - x_segment of every spline
+            std::vector<T> outputs;         //[b][in][out] output of every spline
+            std::vector<T> totals;          //[b][out] summed spline outputs (before normalization)
+        } tape;
         
+        size_t accumulated_samples = 0; //samples whose gradient was accumulated since the last step
+        
+        //optimizer state, flat like grad_offset (the knot y values of spline (i,j) use [grad_offset[i*out+j], grad_offset[i*out+j+1]))
+        aligned_vector<T> optimizer_m, optimizer_v;
+        size_t optimizer_steps = 0;
+        
+        //resizes the tape for batch_size samples
+        void reserve_tape(size_t batch_size);
+        //evaluates all splines at x and writes the segments, offsets, outputs ([in][out]) and summed outputs ([out])
+        //split runs the input rows in parallel (if row_grain is set)
+        void evaluate_sample(const T* x, uint32_t* segments, T* offsets, T* outputs, T* totals, bool split = false) const;
+        //evaluate_sample for the inputs [begin, end) without the sums
+        void evaluate_rows(const T* x, size_t begin, size_t end, uint32_t* segments, T* offsets, T* outputs) const;
+        //evaluates all splines for sample b, records it in the tape and adds the summed outputs to output
+        void record_sample(const std::vector<T> &x, size_t b, T* output, bool split = false);
+        //true if tape row b was recorded for the inputs x
+        bool tape_matches(const std::vector<T> &x, size_t b) const;
+        //backward for tape row b, adds the gradient with respect to the inputs to out
+        void backward_taped(const std::vector<T> &d_y, size_t b, bool apply, T* out);
+        //backward of the inputs [begin, end) of one evaluated sample (segments, offsets, outputs, totals like evaluate_sample)
+        void backward_rows(const uint32_t* segments, const T* offsets, const T* outputs, const T* totals, const std::vector<T> &d_y, size_t begin, size_t end, bool apply, T* out);
+        
+        //true if single sample passes are split across the threads (row_grain set and more than row_grain inputs)
+        bool split_rows() const {
+            return row_grain != 0 && in_size > row_grain;
+        }
+        //calls body(begin, end) for chunks of row_grain inputs on default_pool() if split and split_rows(), else body(0, in_size)
+        void for_rows(bool split, const std::function<void(size_t, size_t)> &body) const {
+            if (split && split_rows()) {
+                default_pool().parallel_for(in_size, row_grain, body);
+            } else {
+                body(0, in_size);
+            }
+        }
+        //backward of one evaluated sample that adds the spline grads to grads (flat, see grad_offset) instead of the splines
+        void accumulate_sample(const uint32_t* segments, const T* offsets, const T* outputs, const T* totals, const std::vector<T> &d_y, T* grads, T* out) const;
+        //data parallel batch backward (if parallel is set), accumulates the grads of the batch without applying them
+        void backward_parallel(const std::vector<std::vector<T>> &x, const std::vector<std::vector<T>> &d_y, bool taped, std::vector<std::vector<T>> &out);
+        //batched forward for the samples [begin, end) (one chunk of the parallel batch forward)
+        void forward_samples(const std::vector<std::vector<T>> &x, size_t begin, size_t end, bool normalize, std::vector<std::vector<T>> &output);
         
         
     public:
         
-        double lr=0.001;//learning_rate
-        std::vector<double> last_output;
+        T lr=T(0.001);//learning_rate
+        
+        //divides the output by its maximum (if the maximum is != 0), used by forward and the inference only copies
+        static void normalize_output(std::span<T> output);
+        std::vector<T> last_output;
+        grad_reduction reduction = grad_reduction::mean; //lr scaling of step()
+        optimizer_t<T> optimizer; //update rule of step() (sgd by default)
+        size_t grain = 16; //samples per task when a batch is split across the threads of default_pool()
+        size_t row_grain = 0; //inputs per task when single sample forward/backward/interpolation is split across the threads (0 = off)
+        bool training = false; //if true forward records a tape (segments, offsets, spline outputs) so backward doesnt recompute the forward pass
+        
         //init with input size and target output size aswell as detail and maximum inpjt value
-        layer(unsigned int _in_size,unsigned int _out_size,unsigned int _detail,double max);
+        //kind bspline makes every update local (see spline_kind), step() then skips the tridiagonal solve
+        //_boundary sets what forward does with inputs outside of [0, max] (see boundary_policy)
+        layer_t(unsigned int _in_size,unsigned int _out_size,unsigned int _detail,T max, spline_kind _kind = spline_kind::natural,
+              boundary_policy _boundary = boundary_policy::error);
         //load from existing layer data
-        layer(std::vector<std::vector<std::vector<std::vector<double>>>> points_list,
-              std::vector<std::vector<std::vector<std::vector<double>>>> params_list
+        layer_t(std::vector<std::vector<std::vector<std::vector<T>>>> points_list,
+              std::vector<std::vector<std::vector<std::vector<T>>>> params_list,
+              spline_kind _kind = spline_kind::natural,
+              boundary_policy _boundary = boundary_policy::error
              );
+        //load from flat arrays, knot_x and knot_y are [in][out][detail + 2], coeffs is [in][out][detail + 1][a,b,c,d]
+        //(throws std::invalid_argument if the sizes dont match)
+        layer_t(unsigned int _in_size, unsigned int _out_size, unsigned int _detail,
+              std::span<const T> knot_x, std::span<const T> knot_y, std::span<const T> coeffs,
+              spline_kind _kind = spline_kind::natural, boundary_policy _boundary = boundary_policy::error);
         
         //call interpolation on all l_splines
         void interpolate_splines();
         //calculate n outputs based one m inputs
-        std::vector<double> forward(std::vector<double> x,bool normalize);
-        //forward with batches
-        std::vector<std::vector<double>> forward(const std::vector<std::vector<double>> &x, bool normalize);
+        std::vector<T> forward(std::vector<T> x,bool normalize);
+        //allocation free forward, x.size() == input size, out.size() == output size (throws otherwise)
+        //does not set last_output or record a tape, so use forward for training
+        void forward_into(std::span<const T> x, std::span<T> out, bool normalize) const;
+        //forward with batches (chunks of grain samples run in parallel on default_pool())
+        std::vector<std::vector<T>> forward(const std::vector<std::vector<T>> &x, bool normalize);
         //calculate gradient with respect to individual spline than sum up for prev layer->backward (=>d_y or if is last layer d_y=loss gradient)
-        std::vector<double> backward(std::vector<double> x,std::vector<double> d_y, bool apply = true);//y might be unused
-        //backward pass for batch inputs
-        std::vector<std::vector<double>> backward(const std::vector<std::vector<double>> &x,std::vector<std::vector<double>> d_y);
+        //if apply is set the grad is applied right away (per spline for sgd, with step() for the other optimizers)
+        std::vector<T> backward(std::vector<T> x,std::vector<T> d_y, bool apply = true);//y might be unused
+        //backward pass for batch inputs, accumulates the grads of all samples and applies them with one step()
+        //if parallel is set the batch is split into chunks of grain samples that run on default_pool()
+        std::vector<std::vector<T>> backward(const std::vector<std::vector<T>> &x,std::vector<std::vector<T>> d_y);
+        //applies the grads accumulated by backward(x, d_y, false) (scaled like reduction) with optimizer and re interpolates all splines once
+        void step();
+        //zeros the optimizer state (e.g. after changing optimizer)
+        void reset_optimizer();
+        
+        //drops the recorded tape (backward falls back to recomputing the forward pass)
+        void clear_tape() {
+            tape.batch_size = 0;
+        }
         
-        std::vector<std::vector<spline>> get_splines() { 
+        unsigned int input_size() const {
+            return in_size;
+        }
+        unsigned int output_size() const {
+            return out_size;
+        }
+        spline_kind get_kind() const {
+            return kind;
+        }
+        //sets the out of range policy of all splines
+        void set_boundary(boundary_policy policy);
+        boundary_policy get_boundary() const {
+            return boundary;
+        }
+        
+        unsigned int get_detail() const {
+            return detail;
+        }
+        
+        std::vector<std::vector<spline_t<T>>> get_splines() { 
             return l_splines;
         }
+        //spline of input i and output j (without copying all splines like get_splines)
+        const spline_t<T>& get_spline(size_t i, size_t j) const {
+            return l_splines[i][j];
+        }
 };
 
+//float and double are compiled into the library
+extern template class layer_t<float>;
+extern template class layer_t<double>;
+
+//default (double precision) name
+using layer = layer_t<double>;
+//single precision name
+using layer_f = layer_t<float>;
+
 }//namespace
 
 #endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef LUT_LAYER_HPP
+#define LUT_LAYER_HPP
+
+#include <cstdint>
+#include "layers.hpp"
+
+namespace SplineNetLib {
+
+//frozen copy of a layer for inference, every spline is sampled on a uniform grid over the range of its input and
+//evaluated with linear interpolation between the grid points (one index computation per input, one multiply add per spline)
+//T is the scalar type (float and double are instantiated in the library)
+template<typename T>
+class lut_layer_t {
+    private:
+
+        unsigned int in_size = 0, out_size = 0;
+        size_t grid = 0; //grid points per input
+        bool quantized = false;
+        boundary_policy boundary = boundary_policy::error; //taken from the source layer
+
+        std::vector<T> x_lo, x_hi, inv_step; //[in] sampled range of input i and grid points per unit of x
+        //[in][grid][value, delta][out] value of every spline at grid point g and the difference to grid point g+1
+        //(like layer::packed, the rows of one grid cell are next to each other)
+        aligned_vector<T> table;
+        //int16 version of table (quantize), value = value_scale * value_q + t * delta_scale * delta_q
+        std::vector<int16_t, aligned_allocator<int16_t>> table_q;
+        aligned_vector<T> scales; //[in][value, delta][out]
+
+        T error = T(0); //upper bound of |forward - layer::forward| of one output (computed on construction)
+
+        //returns the grid cell of x for input i and sets t to the position of x in the cell ([0, 1] inside the range)
+        //throws if boundary is error and x is outside of the sampled range (below it as well, spline::forward only checks above)
+        size_t locate(size_t i, T x, T &t) const;
+        //adds the outputs of all splines of input i at x to out
+        void add_row(size_t i, T x, T* out) const;
+        //table value of spline (i,j) in cell g at t
+        T entry(size_t i, size_t g, size_t j, T t) const;
+
+    public:
+
+        size_t grain = 16; //samples per task of the batched forward
+
+        //samples every spline of source at grid_size points, quantize stores the table as int16 (4x less memory for double)
+        //throws std::invalid_argument if grid_size < 2
+        lut_layer_t(const layer_t<T> &source, size_t grid_size = 1024, bool quantize = false);
+
+        //same as layer::forward
+        std::vector<T> forward(const std::vector<T> &x, bool normalize) const;
+        //allocation free forward, x.size() == input size, out.size() == output size (throws otherwise)
+        void forward_into(std::span<const T> x, std::span<T> out, bool normalize) const;
+        //forward with batches (chunks of grain samples run in parallel on default_pool())
+        std::vector<std::vector<T>> forward(const std::vector<std::vector<T>> &x, bool normalize) const;
+
+        //upper bound of the difference between an output of forward(x, false) and of the source layer (includes quantization
+        //and rounding). holds for every x inside the sampled range, clamped inputs too if all splines of an input have the same
+        //range, not for extrapolated ones
+        T max_error() const {
+            return error;
+        }
+        //bytes used by the table
+        size_t table_bytes() const {
+            return quantized ? table_q.size() * sizeof(int16_t) + scales.size() * sizeof(T) : table.size() * sizeof(T);
+        }
+        size_t grid_size() const {
+            return grid;
+        }
+        bool is_quantized() const {
+            return quantized;
+        }
+        unsigned int input_size() const {
+            return in_size;
+        }
+        unsigned int output_size() const {
+            return out_size;
+        }
+};
+
+//float and double are compiled into the library
+extern template class lut_layer_t<float>;
+extern template class lut_layer_t<double>;
+
+//default (double precision) name
+using lut_layer = lut_layer_t<double>;
+//single precision name
+using lut_layer_f = lut_layer_t<float>;
+
+}//namespace
+
+#endif
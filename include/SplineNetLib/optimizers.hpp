@@ -0,0 +1,50 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef OPTIMIZERS_HPP
+#define OPTIMIZERS_HPP
+
+#include <cstddef>
+
+namespace SplineNetLib {
+
+//update rule used by layer::step
+enum class optimizer_kind {
+    sgd,      //y -= lr * g
+    momentum, //m = beta1 * m + g, y -= lr * m
+    rmsprop,  //v = beta2 * v + (1 - beta2) * g^2, y -= lr * g / (sqrt(v) + eps)
+    adam      //m and v like above (bias corrected), y -= lr * m_hat / (sqrt(v_hat) + eps)
+};
+
+//optimizer settings, the state (m, v) lives in the layer
+template<typename T>
+struct optimizer_t {
+    optimizer_kind kind = optimizer_kind::sgd;
+    T beta1 = T(0.9);   //momentum / adam first moment decay
+    T beta2 = T(0.999); //rmsprop / adam second moment decay
+    T eps = T(1e-8);
+};
+
+//fused update of n parameters y with the gradients grad_scale * grad, updates the state m and v (n values each, unused ones may be nullptr)
+//and resets grad to 0, t is the number of this step (starting at 1, used for the adam bias correction)
+template<typename T>
+void optimizer_update(const optimizer_t<T> &opt, T lr, T grad_scale, size_t t, T* y, T* grad, T* m, T* v, size_t n);
+
+extern template void optimizer_update<float>(const optimizer_t<float>&, float, float, size_t, float*, float*, float*, float*, size_t);
+extern template void optimizer_update<double>(const optimizer_t<double>&, double, double, size_t, double*, double*, double*, double*, size_t);
+
+//default (double precision) name
+using optimizer = optimizer_t<double>;
+//single precision name
+using optimizer_f = optimizer_t<float>;
+
+}//namespace
+
+#endif
@@ -0,0 +1,190 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <thread>
+#include "compiled_nn.hpp"
+
+namespace SplineNetLib {
+
+//bounded lock free queue for exactly one producer and one consumer thread (ring buffer, capacity is rounded up to a power of 2)
+//the blocking push/pop sleep on an atomic wait instead of spinning, close() wakes them up
+template<typename V>
+class spsc_queue {
+    private:
+        std::vector<V> slots;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0}; //next slot to pop (written by the consumer)
+        alignas(64) std::atomic<size_t> tail{0}; //next slot to push (written by the producer)
+        alignas(64) std::atomic<uint32_t> events{0}; //changes on every push, pop and close so waiting threads see progress
+        std::atomic<bool> closed{false};
+
+        void signal() {
+            events.fetch_add(1, std::memory_order_release);
+            events.notify_all();
+        }
+
+    public:
+        explicit spsc_queue(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity) {
+                size *= 2;
+            }
+            slots.resize(size);
+            mask = size - 1;
+        }
+
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+
+        //moves value into the queue and returns true, returns false (value untouched) if the queue is full
+        bool try_push(V &value) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == slots.size()) {
+                return false;
+            }
+            slots[t & mask] = std::move(value);
+            tail.store(t + 1, std::memory_order_release);
+            signal();
+            return true;
+        }
+        //moves the oldest value into value and returns true, returns false if the queue is empty
+        bool try_pop(V &value) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = std::move(slots[h & mask]);
+            head.store(h + 1, std::memory_order_release);
+            signal();
+            return true;
+        }
+        //blocks while the queue is full, returns false if the queue was closed
+        bool push(V &value) {
+            while (true) {
+                uint32_t seen = events.load(std::memory_order_acquire);
+                if (closed.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                if (try_push(value)) {
+                    return true;
+                }
+                events.wait(seen, std::memory_order_acquire);
+            }
+        }
+        //blocks while the queue is empty, returns false if the queue is closed and empty
+        bool pop(V &value) {
+            while (true) {
+                uint32_t seen = events.load(std::memory_order_acquire);
+                if (try_pop(value)) {
+                    return true;
+                }
+                if (closed.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                events.wait(seen, std::memory_order_acquire);
+            }
+        }
+        //wakes all blocked calls, push fails from now on and pop once the queue is empty
+        void close() {
+            closed.store(true, std::memory_order_release);
+            signal();
+        }
+};
+
+//streaming inference, the layers of a network are split into stages and every stage runs on its own thread
+//samples are grouped into micro batches that travel through bounded spsc queues between the stages, so while stage 1
+//works on batch k stage 0 already works on batch k + 1 (throughput scales with the number of stages)
+//push/flush must be called from one thread and pop from one thread (can be the same one), results come back in push order
+template<typename T>
+class nn_pipeline_t {
+    private:
+        struct micro_batch {
+            size_t count = 0;
+            std::vector<T> values;    //[count][width of the stage boundary]
+            std::exception_ptr error; //first exception of a stage, passed on to pop
+        };
+        struct stage_t {
+            compiled_nn_t<T> net;  //layers of the stage
+            bool normalize_output; //normalize was requested and the stage isnt the last one
+        };
+
+        std::vector<std::unique_ptr<stage_t>> stages;
+        std::vector<std::unique_ptr<spsc_queue<micro_batch>>> queues; //queues[s] is the input of stage s, queues.back() the results
+        std::vector<std::thread> workers;
+        size_t micro_size;
+
+        micro_batch pending;   //filled by push until it has micro_size samples
+        micro_batch current;   //result batch pop is reading from
+        size_t current_index = 0;
+        std::atomic<size_t> in_flight{0}; //samples sent to stage 0 that pop didnt return yet
+
+        void run_stage(size_t s);
+        //sends pending to stage 0 (blocking)
+        void send_pending();
+        //returns the next sample of current (rethrows its error)
+        std::vector<T> take_result();
+
+    public:
+
+        //splits the layers of source into num_stages groups of similar cost (0 = one stage per layer, at most one per layer)
+        //normalize works like nn::forward(x, normalize), queue_capacity is the number of micro batches between two stages
+        //throws std::invalid_argument if source has no layers or micro_batch_size is 0
+        nn_pipeline_t(const nn_t<T> &source, bool normalize, size_t num_stages = 0, size_t micro_batch_size = 32, size_t queue_capacity = 8);
+        //stops and joins the stage threads (unfinished results are dropped)
+        ~nn_pipeline_t();
+
+        nn_pipeline_t(const nn_pipeline_t&) = delete;
+        nn_pipeline_t& operator=(const nn_pipeline_t&) = delete;
+
+        //adds one sample, blocks if all queues are full (throws std::invalid_argument if x doesnt have the input size)
+        void push(std::span<const T> x);
+        //sends a partly filled micro batch, needed before the last results can be popped
+        void flush();
+        //next result in push order, blocks until it is there (so with a single thread only pop what was pushed and flushed)
+        //rethrows the exception of a stage (e.g. an out of bounds input), the rest of that micro batch is dropped
+        std::vector<T> pop();
+        //pop without blocking, returns false if the next result isnt there yet
+        bool try_pop(std::vector<T> &y);
+        //streams a whole batch through the pipeline and returns its results (pushes and pops itself, so it must not be
+        //mixed with push/pop, throws std::logic_error if results of push are still pending)
+        std::vector<std::vector<T>> forward(const std::vector<std::vector<T>> &x);
+
+        size_t num_stages() const {
+            return stages.size();
+        }
+        size_t micro_batch_size() const {
+            return micro_size;
+        }
+        unsigned int input_size() const {
+            return stages.front()->net.input_size();
+        }
+        unsigned int output_size() const {
+            return stages.back()->net.output_size();
+        }
+};
+
+extern template class nn_pipeline_t<float>;
+extern template class nn_pipeline_t<double>;
+
+//default (double precision) name
+using nn_pipeline = nn_pipeline_t<double>;
+//single precision name
+using nn_pipeline_f = nn_pipeline_t<float>;
+
+}//namespace
+
+#endif
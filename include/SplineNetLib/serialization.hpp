@@ -0,0 +1,145 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef SERIALIZATION_HPP
+#define SERIALIZATION_HPP
+
+#include <cstdint>
+#include <string>
+#include "SplineNet.hpp"
+
+namespace SplineNetLib {
+
+//binary model format (native byte order):
+//  model_file_header
+//  model_layer_header for every layer (byte offsets of its arrays)
+//  per layer knot_x, knot_y ([in][out][detail + 2]) and coeffs ([in][out][detail + 1][a,b,c,d]), every array starts on a 64 byte boundary
+//a layer is saved as a model with one layer
+constexpr uint32_t model_format_version = 1;
+
+struct model_file_header {
+    char magic[4];        //"SPNL"
+    uint32_t version;     //model_format_version
+    uint32_t scalar_size; //sizeof(T) of the arrays (4 or 8)
+    uint32_t num_layers;
+    uint32_t byte_order;  //0x01020304 written in the byte order of the saving machine
+    uint32_t reserved[3];
+};
+
+struct model_layer_header {
+    uint32_t in_size, out_size, detail;
+    uint32_t kind;     //spline_kind
+    uint32_t boundary; //boundary_policy
+    uint32_t reserved;
+    uint64_t knot_x, knot_y, coeffs; //byte offsets from the start of the file
+};
+
+//read only memory mapping of a whole file (read into memory where mmap isnt available)
+class mapped_file {
+    private:
+        const unsigned char* bytes = nullptr;
+        size_t length = 0;
+        std::vector<unsigned char> buffer; //fallback without mmap
+        bool mapped = false;
+
+    public:
+        //throws std::runtime_error if the file cant be opened
+        explicit mapped_file(const std::string &path);
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        const unsigned char* data() const {
+            return bytes;
+        }
+        size_t size() const {
+            return length;
+        }
+};
+
+//writes layer/network to path (throws std::runtime_error if the file cant be written)
+template<typename T>
+void save(const layer_t<T> &layer, const std::string &path);
+template<typename T>
+void save(const nn_t<T> &network, const std::string &path);
+
+//reads a file written by save (mapped, every array is copied once into the splines)
+//throws std::runtime_error if the file is not a model of this version and scalar type (load_layer also if it has more than one layer)
+template<typename T>
+layer_t<T> load_layer(const std::string &path);
+template<typename T>
+nn_t<T> load_nn(const std::string &path);
+
+//inference directly from the mapped file, nothing is copied or rebuilt so opening a model only costs the mapping
+//forward works like nn::forward (normalize for all layers exept the last one)
+template<typename T>
+class mapped_model_t {
+    private:
+        struct layer_view {
+            unsigned int in_size, out_size, points;
+            boundary_policy boundary;
+            const T* knot_x; //[in][out][points]
+            const T* coeffs; //[in][out][points - 1][a,b,c,d]
+        };
+
+        mapped_file file;
+        std::vector<layer_view> views;
+        size_t max_width = 0; //largest layer input/output size
+
+        //adds the outputs of layer l at x to out
+        void layer_forward(const layer_view &l, const T* x, T* out) const;
+
+    public:
+
+        size_t grain = 16; //samples per task of the batched forward
+
+        //maps path, throws like load_nn
+        explicit mapped_model_t(const std::string &path);
+
+        //allocation free forward, workspace needs workspace_size() values (throws std::invalid_argument if a size is wrong)
+        void forward_into(std::span<const T> x, std::span<T> out, bool normalize, std::span<T> workspace) const;
+        size_t workspace_size() const {
+            return 2 * max_width;
+        }
+        std::vector<T> forward(const std::vector<T> &x, bool normalize) const;
+        //forward with batches (chunks of grain samples run in parallel on default_pool())
+        std::vector<std::vector<T>> forward(const std::vector<std::vector<T>> &x, bool normalize) const;
+
+        size_t num_layers() const {
+            return views.size();
+        }
+        unsigned int input_size() const {
+            return views.front().in_size;
+        }
+        unsigned int output_size() const {
+            return views.back().out_size;
+        }
+};
+
+extern template void save<float>(const layer_t<float>&, const std::string&);
+extern template void save<double>(const layer_t<double>&, const std::string&);
+extern template void save<float>(const nn_t<float>&, const std::string&);
+extern template void save<double>(const nn_t<double>&, const std::string&);
+extern template layer_t<float> load_layer<float>(const std::string&);
+extern template layer_t<double> load_layer<double>(const std::string&);
+extern template nn_t<float> load_nn<float>(const std::string&);
+extern template nn_t<double> load_nn<double>(const std::string&);
+extern template class mapped_model_t<float>;
+extern template class mapped_model_t<double>;
+
+//default (double precision) name
+using mapped_model = mapped_model_t<double>;
+//single precision name
+using mapped_model_f = mapped_model_t<float>;
+
+}//namespace
+
+#endif
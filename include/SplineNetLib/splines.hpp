@@ -17,7 +17,11 @@
 #include <vector>
 #include <stdexcept>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <span>
 #include "CTensor.hpp"
+#include "aligned_allocator.hpp"
 /*
 #include <thread>
 #include <mutex>
@@ -36,42 +40,219 @@ void print_err(T first, Args... args) {
     print_err(args...);
 }
 
+//if true the batched layer backward runs data parallel on the library thread pool (see layer_t::backward)
 extern bool parallel;
 
+//x dependent part of the natural spline system (thomas algorithm), knots never move during training
+//so this is computed once per knot layout and can be shared by every spline with the same knots
+template<typename T>
+struct spline_factorization_t {
+    aligned_vector<T> knot_x; // knots this factorization was built for
+    aligned_vector<T> h, inv_h; // segment widths and their inverse (n-1)
+    aligned_vector<T> inv_l, mu; // 1/l and mu of the forward sweep (n)
+    
+    explicit spline_factorization_t(const aligned_vector<T> &x);
+    
+    bool matches(const aligned_vector<T> &x) const {
+        return knot_x == x;
+    }
+};
+
+template<typename T> class layer_t;
+
+//how the knot y values define the curve
+enum class spline_kind {
+    natural, //natural cubic spline through the knots (global, every change of a knot y needs the tridiagonal solve)
+    bspline  //uniform cubic b-spline, the knot y values are control points and segment i only depends on y[i-1..i+2]
+};
+
+//what forward does with inputs outside of the knots (the check is done once per input in the segment lookup)
+enum class boundary_policy {
+    error,      //print an error and throw std::runtime_error if x > last knot (or nan), like before
+    clamp,      //evaluate at the nearest knot (nan goes to the first knot)
+    extrapolate //continue linearly with the slope at the nearest knot
+};
 
-class spline {
+//cubic spline (natural or b-spline), T is the scalar type (float and double are instantiated in the library)
+template<typename T>
+class spline_t {
+    friend class layer_t<T>; //for the layer wide (bulk) interpolation
 private:
-    std::vector<std::vector<double>> params; // n-1 x m
-    std::vector<std::vector<double>> points; // n x 2
+    //structure of arrays storage, every array is contiguous and cache line aligned
+    aligned_vector<T> knot_x; // n knot x values (sorted)
+    aligned_vector<T> knot_y; // n knot y values
+    aligned_vector<T> coeffs; // (n-1) x 4, interleaved a,b,c,d per segment so one segment is one 4*sizeof(T) byte load
+    
+    aligned_vector<T> grad; //gradient where indx i == point of the spline that grad[i] adjusts
+    
+    std::shared_ptr<const spline_factorization_t<T>> factorization; //created on the first interpolation if not shared (natural only)
     
-    std::vector<double> grad; //gradient where indx i == segment of spline that uses grad[i]
+    spline_kind kind = spline_kind::natural;
+    boundary_policy boundary = boundary_policy::error;
     
+    //segment locator state (knot x values are fixed after construction so this is only set up once)
+    bool uniform = false; //true if all segments (exept the last one which may be wider) have the same width
+    T x_min = 0, inv_h = 0; //first knot and 1/segment width for the direct index computation
+    
+    //checks the knot spacing and picks the direct or the binary search locator
+    void init_locator();
+    //returns the index of the segment that x belongs to (segment i covers (x_i, x_i+1], x is assumed to be <= last knot)
+    size_t find_segment(T x) const;
+    //vectorized part of forward_batch (specialized per T), returns the number of inputs it processed
+    size_t forward_batch_simd(const T* xs, T* ys, size_t n) const;
+    //returns x clamped into the knot range for clamp/extrapolate (branchless min/max), for error it checks x and returns it unchanged
+    T bound_input(T x) const {
+        if (boundary == boundary_policy::error) {
+            if (!(x <= knot_x.back())) {
+                // x does not exist in the control points
+                print_err("x not in range of spline bounds. bounds : [", knot_x.front(), ",", knot_x.back(), "]");
+                throw std::runtime_error("x out of bounds");
+            }
+            return x;
+        }
+        //argument order makes nan end up at the first knot
+        return std::min(knot_x.back(), std::max(knot_x.front(), x));
+    }
+    //evaluates segment i at the bounded input xb (from bound_input), extrapolate adds the slope times x - xb (0 inside the knots)
+    T evaluate_segment(size_t i, T xb, T x) const {
+        const T* p = &coeffs[i * 4];
+        T u = xb - knot_x[i];
+        T y = p[0] + u * (p[1] + u * (p[2] + u * p[3]));
+        if (boundary == boundary_policy::extrapolate) {
+            y += (p[1] + u * (T(2) * p[2] + T(3) * u * p[3])) * (x - xb);
+        }
+        return y;
+    }
+    //b-spline: recomputes the coefficients of the segments [first, last] from the control points (no solve)
+    void update_bspline_segments(size_t first, size_t last);
     
     
     //std::vector<double> batch_outputs; // shape 1d : (batchsize,) cached ouptus from latest fwd pass for the gradient calculation in backward, index by batch
 
 public:
     
-    spline(const std::vector<std::vector<double>> points_list,const std::vector<std::vector<double>> params_list);
+    //kind bspline uses the y values of points_list as control points
+    spline_t(const std::vector<std::vector<T>> points_list,const std::vector<std::vector<T>> params_list, spline_kind _kind = spline_kind::natural);
+    //from flat arrays (x.size() knots, coeffs is [segment][a,b,c,d]), throws like the constructor above
+    spline_t(std::span<const T> x, std::span<const T> y, std::span<const T> _coeffs, spline_kind _kind = spline_kind::natural);
     //default constructor do not use exept to reserve memory
-    spline(){};
+    spline_t(){};
 
     // Member function for interpolation (assuemes points and params are inittialized)
+    //for bspline this only recomputes the coefficients of every segment from its 4 control points
     void interpolation();
     
-    double forward(double x);
+    //returns the cached factorization of this splines knots (creates it if needed)
+    std::shared_ptr<const spline_factorization_t<T>> get_factorization();
+    //use a factorization built for the same knots (e.g. from another spline), throws if the knots differ
+    void share_factorization(std::shared_ptr<const spline_factorization_t<T>> shared);
+    
+    T forward(T x) const;
+    //forward that also returns the segment index of x and the offset x - x_segment (used by the layer training tape)
+    //for clamp/extrapolate the offset is the one of the clamped x
+    T forward_segment(T x, uint32_t &segment, T &offset) const;
+    
+    //evaluates the spline at n inputs xs[0..n) and writes the results to ys (vectorized with AVX2/AVX-512 if enabled)
+    void forward_batch(const T* xs, T* ys, size_t n) const;
+    //span version of forward_batch (xs and ys must have the same size)
+    void forward_batch(std::span<const T> xs, std::span<T> ys) const;
     
     //takes used x value, next layers loss gradient,target, returns this layers loss gradient
-    double backward(double x,double d_y,double y);
+    T backward(T x,T d_y,T y);
+    //writes the indices and weights of the knot y values that get the grad of an output of segment at offset (x - x_segment), returns their count
+    //natural: the upper point of the segment with weight 1, bspline: the 4 control points with their basis weights
+    uint32_t grad_targets(uint32_t segment, T offset, uint32_t* index, T* weight) const {
+        if (kind == spline_kind::natural) {
+            index[0] = segment + 1;
+            weight[0] = T(1);
+            return 1;
+        }
+        uint32_t last = (uint32_t)knot_y.size() - 1;
+        T t = offset / (knot_x[segment + 1] - knot_x[segment]);
+        T s = T(1) - t;
+        //control points outside of the knots are clamped to the first/last one
+        index[0] = (segment > 0) ? segment - 1 : 0;
+        index[1] = segment;
+        index[2] = segment + 1;
+        index[3] = std::min(segment + 2, last);
+        weight[0] = s * s * s / T(6);
+        weight[1] = (T(3) * t * t * t - T(6) * t * t + T(4)) / T(6);
+        weight[2] = ((T(-3) * t + T(3)) * t * t + T(3) * t + T(1)) / T(6);
+        weight[3] = t * t * t / T(6);
+        return 4;
+    }
+    //backward for a segment that is already known (from forward_segment), adds d_E to the grad of the points from grad_targets
+    void accumulate_grad(uint32_t segment, T offset, T d_E) {
+        uint32_t index[4];
+        T weight[4];
+        uint32_t n = grad_targets(segment, offset, index, weight);
+        for (uint32_t k = 0; k < n; k++) {
+            grad[index[k]] += weight[k] * d_E;
+        }
+    }
+    
+    //y -= lr * grad for every point and resets grad, re interpolates unless interpolate is false (e.g. when the layer re interpolates all splines at once)
+    //bspline only recomputes the segments around the changed control points
+    void apply_grad(T lr, bool interpolate = true);
+    
+    spline_kind get_kind() const {
+        return kind;
+    }
     
-    void apply_grad(double lr);
+    //sets what forward does with inputs outside of the knots
+    void set_boundary(boundary_policy policy) {
+        boundary = policy;
+    }
+    boundary_policy get_boundary() const {
+        return boundary;
+    }
     
+    //flat views of the knots and the coefficients ([segment][a,b,c,d])
+    std::span<const T> get_knot_x() const {
+        return knot_x;
+    }
+    std::span<const T> get_knot_y() const {
+        return knot_y;
+    }
+    std::span<const T> get_coeffs() const {
+        return coeffs;
+    }
     
-    std::vector<std::vector<double>> get_points(); 
+    //x of the first and the last knot (the range forward is defined on)
+    T min_x() const {
+        return knot_x.front();
+    }
+    T max_x() const {
+        return knot_x.back();
+    }
+    //1 / segment width if the segment locator computes the segment directly (uniform knots), 0 if it uses the binary search
+    T uniform_inv_h() const {
+        return inv_h;
+    }
     
-    std::vector<std::vector<double>> get_params();
+    
+    std::vector<std::vector<T>> get_points() const;
+    
+    std::vector<std::vector<T>> get_params() const;
 };
 
+//the vectorized kernels are written per scalar type
+template<> size_t spline_t<double>::forward_batch_simd(const double* xs, double* ys, size_t n) const;
+template<> size_t spline_t<float>::forward_batch_simd(const float* xs, float* ys, size_t n) const;
+
+//float and double are compiled into the library
+extern template struct spline_factorization_t<float>;
+extern template struct spline_factorization_t<double>;
+extern template class spline_t<float>;
+extern template class spline_t<double>;
+
+//default (double precision) names
+using spline_factorization = spline_factorization_t<double>;
+using spline = spline_t<double>;
+//single precision names
+using spline_factorization_f = spline_factorization_t<float>;
+using spline_f = spline_t<float>;
+
 }//namespace
 
 #endif // SPLINE_HPP
\ No newline at end of file
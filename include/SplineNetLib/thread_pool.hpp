@@ -0,0 +1,84 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace SplineNetLib {
+
+//fixed size pool of worker threads used for the batched layer/network passes
+class thread_pool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex tasks_mutex;
+    std::condition_variable tasks_cv;
+    bool stopping = false;
+
+    void worker_loop();
+
+public:
+    //num_threads == 0 uses std::thread::hardware_concurrency()
+    explicit thread_pool(unsigned int num_threads = 0);
+    //finishes all queued tasks, then joins the workers
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    //number of worker threads
+    unsigned int size() const {
+        return (unsigned int)workers.size();
+    }
+
+    //queues f and returns a future for its result (exceptions are passed through the future)
+    template<typename F>
+    auto submit(F &&f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using result_t = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(f));
+        std::future<result_t> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    //calls body(begin, end) for chunks of at most grain indices covering [0, n) and blocks until all chunks are done
+    //the calling thread works on chunks too, so this can be called from inside a pool task without deadlocking
+    //the first exception thrown by body is rethrown after all chunks finished
+    void parallel_for(size_t n, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+    //queues a task without a future (an exception thrown by task is dropped, catch it inside task to see it)
+    void enqueue(std::function<void()> task);
+};
+
+//pool shared by the library (created on first use with set_num_threads threads, default hardware_concurrency)
+thread_pool& default_pool();
+//changes the number of threads of default_pool (1 = everything runs on the calling thread)
+//must not be called while the pool is in use
+void set_num_threads(unsigned int num_threads);
+//number of threads of default_pool
+unsigned int get_num_threads();
+//finishes the queued tasks of default_pool and joins its threads (it is recreated with the same size on the next use)
+//the tasks may still use default_pool while it drains, e.g. before the python interpreter shuts down
+void reset_default_pool();
+
+}//namespace
+
+#endif
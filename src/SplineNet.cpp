@@ -9,23 +9,30 @@
 
 
 #include "../include/SplineNetLib/SplineNet.hpp"
+#include "../include/SplineNetLib/compiled_nn.hpp"
+
+#include <limits>
+#include <numeric>
+#include <random>
 
 namespace SplineNetLib {
 
-nn::nn(int num_layers,std::vector<unsigned int> in,std::vector<unsigned int> out,std::vector<unsigned int> detail,std::vector<double> max){
+template<typename T>
+nn_t<T>::nn_t(int num_layers,std::vector<unsigned int> in,std::vector<unsigned int> out,std::vector<unsigned int> detail,std::vector<T> max, spline_kind kind, boundary_policy boundary){
     
     //create layer vector to hold future layers
-    std::vector<layer> new_layers;
+    std::vector<layer_t<T>> new_layers;
 
     //init the layers
     for (int i=0;i<num_layers;i++){
-        new_layers.push_back(layer(in[i],out[i],detail[i],max[i]));//layer constructor 1 without loading old parameters
+        new_layers.push_back(layer_t<T>(in[i],out[i],detail[i],max[i],kind,boundary));//layer constructor 1 without loading old parameters
     }
     //assign layers
     layers=new_layers;
 }
 
-std::vector<double> nn::forward(std::vector<double> x,bool normalize){
+template<typename T>
+std::vector<T> nn_t<T>::forward(std::vector<T> x,bool normalize){
     //call forward for all layers
     for (size_t i=0; i<layers.size();i++){
         
@@ -43,7 +50,166 @@ std::vector<double> nn::forward(std::vector<double> x,bool normalize){
     return x;
 }
 
-std::vector<double> nn::backward(std::vector<double> x,std::vector<double> d_y){
+template<typename T>
+std::vector<std::vector<T>> nn_t<T>::forward(const std::vector<std::vector<T>> &x, bool normalize) {
+    if (training) {
+        checkpoint_stride = choose_checkpoint_stride(x.size());
+        activations.assign(layers.size(), {});
+        activations_normalized = normalize;
+    }
+    std::vector<std::vector<T>> y = x;
+    for (size_t i = 0; i < layers.size(); i++) {
+        if (training && i % checkpoint_stride == 0) {
+            activations[i] = y;
+        }
+        //normalize for all layers exept last one
+        y = layers[i].forward(y, normalize && i != layers.size() - 1);
+    }
+    return y;
+}
+
+template<typename T>
+size_t nn_t<T>::choose_checkpoint_stride(size_t batch_size) const {
+    if (activation_budget == 0) {
+        return 1;
+    }
+    for (size_t stride = 1; stride < layers.size(); stride++) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < layers.size(); i += stride) {
+            bytes += batch_size * layers[i].input_size() * sizeof(T);
+        }
+        if (bytes <= activation_budget) {
+            return stride;
+        }
+    }
+    //only the network input is kept
+    return std::max<size_t>(layers.size(), 1);
+}
+
+template<typename T>
+std::vector<std::vector<T>> nn_t<T>::backward(const std::vector<std::vector<T>> &x, std::vector<std::vector<T>> d_y) {
+    if (activations.size() != layers.size() || layers.empty() || activations[0] != x) {
+        throw std::invalid_argument("nn backward: call the batched forward with training set on the same batch first");
+    }
+    //walk the checkpoints from the last to the first, the inputs between two checkpoints are recomputed
+    //(the layers below the current one were not updated yet, so the recomputed inputs are the ones of the forward pass)
+    size_t num_segments = (layers.size() + checkpoint_stride - 1) / checkpoint_stride;
+    for (size_t segment = num_segments; segment-- > 0;) {
+        size_t start = segment * checkpoint_stride;
+        size_t end = std::min(start + checkpoint_stride, layers.size());
+        std::vector<std::vector<std::vector<T>>> inputs(end - start);
+        inputs[0] = std::move(activations[start]);
+        for (size_t i = start + 1; i < end; i++) {
+            inputs[i - start] = layers[i - 1].forward(inputs[i - start - 1], activations_normalized && i - 1 != layers.size() - 1);
+        }
+        for (size_t i = end; i-- > start;) {
+            d_y = layers[i].backward(inputs[i - start], d_y);
+        }
+    }
+    //the layers changed so the kept inputs are outdated
+    activations.clear();
+    return d_y;
+}
+
+template<typename T>
+size_t nn_t<T>::workspace_size() const {
+    size_t widest = 0;
+    for (const layer_t<T> &l : layers) {
+        widest = std::max(widest, (size_t)l.output_size());
+    }
+    return 2 * widest;
+}
+
+template<typename T>
+void nn_t<T>::forward_into(std::span<const T> x, std::span<T> out, bool normalize) {
+    size_t needed = workspace_size();
+    if (workspace.size() < needed) {
+        workspace.resize(needed);
+    }
+    static_cast<const nn_t<T>&>(*this).forward_into(x, out, normalize, workspace);
+}
+
+template<typename T>
+void nn_t<T>::forward_into(std::span<const T> x, std::span<T> out, bool normalize, std::span<T> workspace) const {
+    if (layers.empty()) {
+        throw std::invalid_argument("forward_into: network has no layers");
+    }
+    size_t half = workspace.size() / 2;
+    if (half * 2 < workspace_size()) {
+        throw std::invalid_argument("forward_into: workspace is smaller than workspace_size()");
+    }
+    //every layer reads from the buffer the previous one wrote to, the last layer writes to out
+    std::span<const T> in = x;
+    for (size_t i = 0; i < layers.size(); i++) {
+        bool last = (i == layers.size() - 1);
+        std::span<T> target = last ? out : workspace.subspan((i % 2) * half, layers[i].output_size());
+        //normalize for all layers exept last one
+        layers[i].forward_into(in, target, normalize && !last);
+        in = target;
+    }
+}
+
+template<typename T>
+void nn_t<T>::forward_async(std::vector<T> x, bool normalize, std::function<void(std::vector<T>, std::exception_ptr)> done) const {
+    default_pool().enqueue([this, x = std::move(x), normalize, done = std::move(done)]() {
+        std::vector<T> output(layers.empty() ? 0 : layers.back().output_size()), workspace(workspace_size());
+        std::exception_ptr error;
+        try {
+            forward_into(x, output, normalize, workspace);
+        } catch (...) {
+            error = std::current_exception();
+            output.clear();
+        }
+        //done has nobody to report to on the worker thread, an escaping exception would terminate the process
+        try {
+            done(std::move(output), error);
+        } catch (const std::exception &e) {
+            print_err("forward_async: done threw, the exception is dropped: ", e.what());
+        } catch (...) {
+            print_err("forward_async: done threw, the exception is dropped");
+        }
+    });
+}
+
+template<typename T>
+std::future<std::vector<T>> nn_t<T>::forward_async(std::vector<T> x, bool normalize) const {
+    auto promise = std::make_shared<std::promise<std::vector<T>>>();
+    std::future<std::vector<T>> result = promise->get_future();
+    forward_async(std::move(x), normalize, [promise](std::vector<T> y, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(y));
+        }
+    });
+    return result;
+}
+
+template<typename T>
+std::future<std::vector<std::vector<T>>> nn_t<T>::forward_async(std::vector<std::vector<T>> x, bool normalize) const {
+    return default_pool().submit([this, x = std::move(x), normalize]() {
+        if (layers.empty()) {
+            throw std::invalid_argument("forward_async: network has no layers");
+        }
+        std::vector<std::vector<T>> output(x.size(), std::vector<T>(layers.back().output_size()));
+        //parallel_for works from inside a pool task (the task thread takes chunks too)
+        default_pool().parallel_for(x.size(), layers.front().grain, [&](size_t begin, size_t end) {
+            std::vector<T> workspace(workspace_size());
+            for (size_t b = begin; b < end; b++) {
+                forward_into(x[b], output[b], normalize, workspace);
+            }
+        });
+        return output;
+    });
+}
+
+template<typename T>
+compiled_nn_t<T> nn_t<T>::compile(bool normalize) const {
+    return compiled_nn_t<T>(*this, normalize);
+}
+
+template<typename T>
+std::vector<T> nn_t<T>::backward(std::vector<T> x,std::vector<T> d_y){
     //call backward for all oayers from last to first
     for (int i=layers.size()-1;i>=0;i--){
         //activation backward here
@@ -55,5 +221,94 @@ std::vector<double> nn::backward(std::vector<double> x,std::vector<double> d_y){
     //return error gradient || loss gradient
     return d_y;
 }
+
+template<typename T>
+fit_result_t<T> nn_t<T>::fit(const std::vector<std::vector<T>> &x, const std::vector<std::vector<T>> &y, const fit_options_t<T> &options) {
+    if (x.empty() || x.size() != y.size()) {
+        throw std::invalid_argument("fit: x and y must have the same (non zero) number of samples");
+    }
+    if (options.batch_size == 0) {
+        throw std::invalid_argument("fit: batch_size must be > 0");
+    }
+    
+    fit_result_t<T> result;
+    std::vector<size_t> order(x.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 rng(options.seed);
+    
+    //fit needs the kept layer inputs, the previous setting is restored on return (or exception)
+    struct restore_t {
+        bool &flag;
+        bool value;
+        ~restore_t() { flag = value; }
+    } restore{training, training};
+    training = true;
+    T best_loss = std::numeric_limits<T>::max();
+    size_t epochs_without_improvement = 0;
+    std::vector<std::vector<T>> batch_x, batch_y, d_y;
+    
+    for (size_t epoch = 0; epoch < options.epochs; epoch++) {
+        if (options.shuffle) {
+            std::shuffle(order.begin(), order.end(), rng);
+        }
+        T epoch_loss = T(0);
+        size_t num_values = 0;
+        
+        for (size_t begin = 0; begin < x.size(); begin += options.batch_size) {
+            size_t end = std::min(begin + options.batch_size, x.size());
+            batch_x.resize(end - begin);
+            batch_y.resize(end - begin);
+            for (size_t b = begin; b < end; b++) {
+                batch_x[b - begin] = x[order[b]];
+                batch_y[b - begin] = y[order[b]];
+            }
+            
+            std::vector<std::vector<T>> pred = forward(batch_x, options.normalize);
+            //mse, d_y = d loss / d pred per sample (the layers average over the batch)
+            d_y.resize(pred.size());
+            for (size_t b = 0; b < pred.size(); b++) {
+                if (batch_y[b].size() != pred[b].size()) {
+                    throw std::invalid_argument("fit: targets must have the output size of the network");
+                }
+                d_y[b].resize(pred[b].size());
+                for (size_t j = 0; j < pred[b].size(); j++) {
+                    T error = pred[b][j] - batch_y[b][j];
+                    epoch_loss += error * error;
+                    d_y[b][j] = T(2) * error;
+                }
+                num_values += pred[b].size();
+            }
+            backward(batch_x, d_y);
+        }
+        
+        epoch_loss /= (T)std::max<size_t>(num_values, 1);
+        result.epoch_loss.push_back(epoch_loss);
+        if (options.on_epoch) {
+            options.on_epoch(epoch, epoch_loss);
+        }
+        
+        //early stopping
+        if (epoch_loss < best_loss - options.min_delta) {
+            best_loss = epoch_loss;
+            epochs_without_improvement = 0;
+        } else if (options.patience != 0 && ++epochs_without_improvement >= options.patience) {
+            result.stopped_early = true;
+            break;
+        }
+    }
+    return result;
+}
+
+template<typename T>
+fit_result_t<T> nn_t<T>::fit(const std::vector<std::vector<T>> &x, const std::vector<std::vector<T>> &y, size_t epochs, size_t batch_size, bool shuffle) {
+    fit_options_t<T> options;
+    options.epochs = epochs;
+    options.batch_size = batch_size;
+    options.shuffle = shuffle;
+    return fit(x, y, options);
+}
+
+template class nn_t<float>;
+template class nn_t<double>;
     
 }
\ No newline at end of file
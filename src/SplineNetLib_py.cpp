@@ -18,7 +18,13 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>  // To handle STL types like std::string, std::vector
 #include <pybind11/operators.h>
+#include <pybind11/functional.h> // fit on_epoch callback
 #include "SplineNetLib/SplineNet.hpp"    // Header for the library
+#include "SplineNetLib/lut_layer.hpp"
+#include "SplineNetLib/serialization.hpp"
+#include "SplineNetLib/compiled_nn.hpp"
+#include "SplineNetLib/pipeline.hpp"
+#include "SplineNetLib/batcher.hpp"
 
 
 namespace py = pybind11;
@@ -65,26 +71,307 @@ std::vector<size_t> get_shape(const py::list& py_list) {
 }
 
 
+//concurrent.futures.Future that is completed from a library worker thread (asyncio can await it with asyncio.wrap_future)
+//returns the future and the callback that completes it, owner (the python object of the network) stays alive until then
+template <typename R>
+std::pair<py::object, std::function<void(R, std::exception_ptr)>> python_future(py::object owner) {
+    py::object future = py::module_::import("concurrent.futures").attr("Future")();
+    auto handles = std::make_shared<std::pair<py::object, py::object>>(future, std::move(owner));
+    auto complete = [handles](R result, std::exception_ptr error) mutable {
+        py::gil_scoped_acquire gil;
+        auto keep = std::move(handles); //the python objects are released while the gil is held
+        py::object &f = keep->first;
+        //this runs on a library thread, nothing may escape (it would terminate the interpreter)
+        try {
+            if (f.attr("cancelled")().template cast<bool>()) {
+                return;
+            }
+            py::object python_error;
+            try {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                f.attr("set_result")(py::cast(std::move(result)));
+            } catch (py::error_already_set &e) {
+                python_error = e.value();
+            } catch (const std::invalid_argument &e) {
+                python_error = py::reinterpret_borrow<py::object>(PyExc_ValueError)(e.what());
+            } catch (const std::exception &e) {
+                python_error = py::reinterpret_borrow<py::object>(PyExc_RuntimeError)(e.what());
+            } catch (...) {
+                python_error = py::reinterpret_borrow<py::object>(PyExc_RuntimeError)("unknown exception in forward");
+            }
+            if (python_error) {
+                f.attr("set_exception")(python_error);
+            }
+        } catch (py::error_already_set &e) {
+            //e.g. the future was cancelled in between, there is nobody to raise it to so python prints it as unraisable
+            e.discard_as_unraisable(f);
+        } catch (const std::exception &e) {
+            PyErr_SetString(PyExc_RuntimeError, e.what());
+            PyErr_WriteUnraisable(f.ptr());
+        }
+    };
+    return {future, complete};
+}
+
+//binds SplineNetLib::spline_t<T> as a python class called name
+template <typename T>
+void bind_spline(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::spline_t<T>>(m, name)
+        .def(py::init<const std::vector < std::vector < T>>&, const std::vector < std::vector < T>>&, SplineNetLib::spline_kind>(),
+             py::arg("points"), py::arg("params"), py::arg("kind") = SplineNetLib::spline_kind::natural)  // Bind constructor
+        .def("interpolation",&SplineNetLib::spline_t<T>::interpolation,"None (None), interpolates the spline based on its points")
+        .def("forward",&SplineNetLib::spline_t<T>::forward,"double (double x), evaluates spline at x (if x in bounds)")
+        .def("forward_batch",[](SplineNetLib::spline_t<T>& self, const std::vector<T>& xs) {
+            std::vector<T> ys(xs.size());
+            self.forward_batch(xs.data(), ys.data(), xs.size());
+            return ys;
+        },"[double] ([double] xs), evaluates spline at all xs (if all xs in bounds)")
+        .def("backward",&SplineNetLib::spline_t<T>::backward,"double (double in,double d_y,double out), uses previous input, loss gradient and last output for gradient descent")
+        .def("apply_grad",&SplineNetLib::spline_t<T>::apply_grad,py::arg("lr"),py::arg("interpolate") = true,"None (double lr, bool interpolate = True),apply grad from backward * lr (and re interpolate)")
+        .def("get_points",&SplineNetLib::spline_t<T>::get_points,"[[double]] (None),return spline points like [[x0,y0],...,[xn,yn]]")
+        .def("get_params",&SplineNetLib::spline_t<T>::get_params,"[[double]] (None),return spline parameters/coefficients like [[a0,b0,c0,d0],...,[an,bn,cn,dn]]")
+        .def("get_kind",&SplineNetLib::spline_t<T>::get_kind,"spline_kind (None), natural or bspline")
+        .def_property("boundary",&SplineNetLib::spline_t<T>::get_boundary,&SplineNetLib::spline_t<T>::set_boundary,"boundary_policy, what forward does with x outside of the points (error, clamp or extrapolate)");
+}
+
+//binds SplineNetLib::optimizer_t<T> as a python class called name
+template <typename T>
+void bind_optimizer(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::optimizer_t<T>>(m, name)
+        .def(py::init<>())
+        .def(py::init([](SplineNetLib::optimizer_kind kind, T beta1, T beta2, T eps) {
+            return SplineNetLib::optimizer_t<T>{kind, beta1, beta2, eps};
+        }), py::arg("kind"), py::arg("beta1") = T(0.9), py::arg("beta2") = T(0.999), py::arg("eps") = T(1e-8))
+        .def_readwrite("kind",&SplineNetLib::optimizer_t<T>::kind)
+        .def_readwrite("beta1",&SplineNetLib::optimizer_t<T>::beta1)
+        .def_readwrite("beta2",&SplineNetLib::optimizer_t<T>::beta2)
+        .def_readwrite("eps",&SplineNetLib::optimizer_t<T>::eps);
+}
+
+//binds SplineNetLib::layer_t<T> as a python class called name
+template <typename T>
+void bind_layer(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::layer_t<T>>(m, name)
+        .def(py::init<unsigned int, unsigned int, unsigned int, T, SplineNetLib::spline_kind, SplineNetLib::boundary_policy>(),
+             py::arg("in_size"), py::arg("out_size"), py::arg("detail"), py::arg("max"), py::arg("kind") = SplineNetLib::spline_kind::natural,
+             py::arg("boundary") = SplineNetLib::boundary_policy::error)//in size, out size, detail (num of parameters -2), max (maximum input value that spline processes)
+        .def(py::init<std::vector<std::vector<std::vector<std::vector<T>>>>, std::vector<std::vector<std::vector<std::vector<T>>>>, SplineNetLib::spline_kind, SplineNetLib::boundary_policy>(),
+             py::arg("points"), py::arg("params"), py::arg("kind") = SplineNetLib::spline_kind::natural, py::arg("boundary") = SplineNetLib::boundary_policy::error)
+        .def("interpolate_splines",&SplineNetLib::layer_t<T>::interpolate_splines,"None (None), calls interpolation on all splines in the layer")
+        .def("forward",py::overload_cast<std::vector<T>, bool>(&SplineNetLib::layer_t<T>::forward),"[double] ([double] x, bool normalize), forward call for single input sample")
+        .def("forward",py::overload_cast<const std::vector<std::vector<T>> &, bool>(&SplineNetLib::layer_t<T>::forward),"[[double]] (const [[double]] &x, bool normalize), forward call for batches")
+        .def("backward",py::overload_cast<std::vector<T>,std::vector<T> , bool>(&SplineNetLib::layer_t<T>::backward),"[double] ([double] x,[double]d_y,bool normalize), takes input x, loss gradient d_y and bool apply_grad,returns propageted loss (applies grad to all splines if True)")
+        .def("backward",py::overload_cast<const std::vector<std::vector<T>> &,std::vector<std::vector<T>> >(&SplineNetLib::layer_t<T>::backward),"backward but for batches (accumulates the grads of the batch and applies them with one step)")
+        .def("get_splines",&SplineNetLib::layer_t<T>::get_splines,"[[SplineNetLib::spline]] (None), returns all splines in the layer")
+        .def("get_kind",&SplineNetLib::layer_t<T>::get_kind,"spline_kind (None), kind of the splines in the layer")
+        .def_property("boundary",&SplineNetLib::layer_t<T>::get_boundary,&SplineNetLib::layer_t<T>::set_boundary,"boundary_policy, what forward does with inputs outside of [0, max] (error, clamp or extrapolate)")
+        .def("step",&SplineNetLib::layer_t<T>::step,"None (None), applies the grads accumulated by backward(x, d_y, False) and re interpolates all splines once")
+        .def_readwrite("reduction",&SplineNetLib::layer_t<T>::reduction)
+        .def_readwrite("optimizer",&SplineNetLib::layer_t<T>::optimizer)
+        .def("reset_optimizer",&SplineNetLib::layer_t<T>::reset_optimizer,"None (None), zeros the optimizer state (momentum/adam/rmsprop averages)")
+        .def("clear_tape",&SplineNetLib::layer_t<T>::clear_tape,"None (None), drops the forward record used by backward in training mode")
+        .def_readwrite("training",&SplineNetLib::layer_t<T>::training)
+        .def_readwrite("grain",&SplineNetLib::layer_t<T>::grain)
+        .def_readwrite("row_grain",&SplineNetLib::layer_t<T>::row_grain)
+        .def("save",[](const SplineNetLib::layer_t<T> &self, const std::string &path) { SplineNetLib::save(self, path); },
+             py::arg("path"),"None (str path), writes the splines of the layer to a binary model file")
+        .def_readwrite("lr", &SplineNetLib::layer_t<T>::lr);
+}
+
+//binds SplineNetLib::lut_layer_t<T> as a python class called name
+template <typename T>
+void bind_lut_layer(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::lut_layer_t<T>>(m, name)
+        .def(py::init<const SplineNetLib::layer_t<T>&, size_t, bool, size_t>(),
+             py::arg("layer"), py::arg("grid_size") = 1024, py::arg("quantize") = false)//frozen copy of layer
+        .def("forward",py::overload_cast<const std::vector<T>&, bool>(&SplineNetLib::lut_layer_t<T>::forward, py::const_),"[double] ([double] x, bool normalize), forward call for single input sample")
+        .def("forward",py::overload_cast<const std::vector<std::vector<T>>&, bool>(&SplineNetLib::lut_layer_t<T>::forward, py::const_),"[[double]] ([[double]] x, bool normalize), forward call for batches")
+        .def("max_error",&SplineNetLib::lut_layer_t<T>::max_error,"double (None), upper bound of the difference between an output of the table and of the layer (normalize=False)")
+        .def("table_bytes",&SplineNetLib::lut_layer_t<T>::table_bytes,"int (None), memory used by the table")
+        .def("grid_size",&SplineNetLib::lut_layer_t<T>::grid_size,"int (None), grid points per input")
+        .def("is_quantized",&SplineNetLib::lut_layer_t<T>::is_quantized,"bool (None), True if the table is stored as int16")
+        .def_readwrite("grain",&SplineNetLib::lut_layer_t<T>::grain);
+}
+
+//binds SplineNetLib::mapped_model_t<T> as a python class called name
+template <typename T>
+void bind_mapped_model(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::mapped_model_t<T>>(m, name)
+        .def(py::init<const std::string&>(), py::arg("path"))//maps a file written by nn.save / layer.save
+        .def("forward",py::overload_cast<const std::vector<T>&, bool>(&SplineNetLib::mapped_model_t<T>::forward, py::const_),"[double] ([double] x, bool normalize), forward call for single input sample")
+        .def("forward",py::overload_cast<const std::vector<std::vector<T>>&, bool>(&SplineNetLib::mapped_model_t<T>::forward, py::const_),"[[double]] ([[double]] x, bool normalize), forward call for batches")
+        .def("num_layers",&SplineNetLib::mapped_model_t<T>::num_layers)
+        .def("input_size",&SplineNetLib::mapped_model_t<T>::input_size)
+        .def("output_size",&SplineNetLib::mapped_model_t<T>::output_size)
+        .def_readwrite("grain",&SplineNetLib::mapped_model_t<T>::grain);
+}
+
+//binds SplineNetLib::compiled_nn_t<T> as a python class called name
+template <typename T>
+void bind_compiled_nn(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::compiled_nn_t<T>>(m, name)
+        .def("forward",py::overload_cast<const std::vector<T>&>(&SplineNetLib::compiled_nn_t<T>::forward, py::const_),
+             py::call_guard<py::gil_scoped_release>(),"[double] ([double] x), forward call for single input sample (normalize was fixed by compile)")
+        .def("forward",py::overload_cast<const std::vector<std::vector<T>>&>(&SplineNetLib::compiled_nn_t<T>::forward, py::const_),
+             py::call_guard<py::gil_scoped_release>(),"[[double]] ([[double]] x), forward call for batches")
+        .def("forward_async",[](py::object self, std::vector<T> x) {
+            auto [future, complete] = python_future<std::vector<T>>(self);
+            const SplineNetLib::compiled_nn_t<T> &net = self.cast<const SplineNetLib::compiled_nn_t<T>&>();
+            SplineNetLib::default_pool().enqueue([&net, x = std::move(x), complete = std::move(complete)]() {
+                std::vector<T> y;
+                std::exception_ptr error;
+                try {
+                    y = net.forward(x);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                complete(std::move(y), error);
+            });
+            return future;
+        },
+        py::arg("x"),"concurrent.futures.Future ([double] x), forward on the library threads without the gil")
+        .def("arena_bytes",&SplineNetLib::compiled_nn_t<T>::arena_bytes,"int (None), memory used by the coefficients")
+        .def("normalizes",&SplineNetLib::compiled_nn_t<T>::normalizes)
+        .def("num_layers",&SplineNetLib::compiled_nn_t<T>::num_layers)
+        .def("input_size",&SplineNetLib::compiled_nn_t<T>::input_size)
+        .def("output_size",&SplineNetLib::compiled_nn_t<T>::output_size)
+        .def_readwrite("grain",&SplineNetLib::compiled_nn_t<T>::grain);
+}
+
+//binds SplineNetLib::nn_pipeline_t<T> as a python class called name
+template <typename T>
+void bind_pipeline(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::nn_pipeline_t<T>>(m, name)
+        .def(py::init<const SplineNetLib::nn_t<T>&, bool, size_t, size_t, size_t>(),
+             py::arg("network"), py::arg("normalize"), py::arg("num_stages") = 0, py::arg("micro_batch_size") = 32, py::arg("queue_capacity") = 8)
+        .def("push",[](SplineNetLib::nn_pipeline_t<T> &self, const std::vector<T> &x) { self.push(x); },
+             py::arg("x"), py::call_guard<py::gil_scoped_release>(),"None ([double] x), adds one sample (blocks while the pipeline is full)")
+        .def("flush",&SplineNetLib::nn_pipeline_t<T>::flush,py::call_guard<py::gil_scoped_release>(),"None (None), sends a partly filled micro batch")
+        .def("pop",&SplineNetLib::nn_pipeline_t<T>::pop,py::call_guard<py::gil_scoped_release>(),"[double] (None), next result in push order (blocks until it is there)")
+        .def("forward",&SplineNetLib::nn_pipeline_t<T>::forward,py::call_guard<py::gil_scoped_release>(),"[[double]] ([[double]] x), streams a batch through all stages")
+        .def("num_stages",&SplineNetLib::nn_pipeline_t<T>::num_stages)
+        .def("micro_batch_size",&SplineNetLib::nn_pipeline_t<T>::micro_batch_size);
+}
+
+//binds SplineNetLib::inference_batcher_t<T> as a python class called name
+template <typename T>
+void bind_batcher(py::module_ &m, const char* name) {
+    py::class_<SplineNetLib::inference_batcher_t<T>>(m, name)
+        .def(py::init([](const SplineNetLib::nn_t<T> &network, bool normalize, size_t max_batch, size_t max_wait_us) {
+                 return new SplineNetLib::inference_batcher_t<T>(network, normalize, max_batch, std::chrono::microseconds(max_wait_us));
+             }),
+             py::arg("network"), py::arg("normalize"), py::arg("max_batch") = 32, py::arg("max_wait_us") = 500)
+        .def("forward",&SplineNetLib::inference_batcher_t<T>::forward,py::arg("x"),py::call_guard<py::gil_scoped_release>(),
+             "[double] ([double] x), queues one sample and waits for its result (concurrent calls are batched)")
+        .def("num_batches",&SplineNetLib::inference_batcher_t<T>::num_batches)
+        .def("num_samples",&SplineNetLib::inference_batcher_t<T>::num_samples);
+}
+
+//binds SplineNetLib::nn_t<T> as a python class called name and its fit result as result_name
+template <typename T>
+void bind_nn(py::module_ &m, const char* name, const char* result_name) {
+    py::class_<SplineNetLib::fit_result_t<T>>(m, result_name)
+        .def_readonly("epoch_loss",&SplineNetLib::fit_result_t<T>::epoch_loss)
+        .def_readonly("stopped_early",&SplineNetLib::fit_result_t<T>::stopped_early);
+    
+    py::class_<SplineNetLib::nn_t<T>>(m, name)
+        .def(py::init<int, std::vector<unsigned int>, std::vector<unsigned int>, std::vector<unsigned int>, std::vector<T>, SplineNetLib::spline_kind, SplineNetLib::boundary_policy>(),
+             py::arg("num_layers"), py::arg("in_sizes"), py::arg("out_sizes"), py::arg("details"), py::arg("max_values"), py::arg("kind") = SplineNetLib::spline_kind::natural,
+             py::arg("boundary") = SplineNetLib::boundary_policy::error)//num layers, in sizes, out sizes, details, max values
+        .def("forward",py::overload_cast<std::vector<T>, bool>(&SplineNetLib::nn_t<T>::forward),"[double] ([double] x, bool normalize), forward call for single input sample")
+        .def("forward",py::overload_cast<const std::vector<std::vector<T>> &, bool>(&SplineNetLib::nn_t<T>::forward),"[[double]] ([[double]] x, bool normalize), forward call for batches (keeps the layer inputs if training is True)")
+        .def("backward",py::overload_cast<std::vector<T>, std::vector<T>>(&SplineNetLib::nn_t<T>::backward),"[double] ([double] x, [double] d_y), backward for the last single sample forward")
+        .def("backward",py::overload_cast<const std::vector<std::vector<T>> &, std::vector<std::vector<T>>>(&SplineNetLib::nn_t<T>::backward),"[[double]] ([[double]] x, [[double]] d_y), backward for the last batched forward (needs training = True)")
+        .def("fit",[](SplineNetLib::nn_t<T> &self, const std::vector<std::vector<T>> &x, const std::vector<std::vector<T>> &y,
+                      size_t epochs, size_t batch_size, bool shuffle, bool normalize, size_t patience, T min_delta, unsigned int seed,
+                      std::function<void(size_t, T)> on_epoch) {
+            SplineNetLib::fit_options_t<T> options;
+            options.epochs = epochs;
+            options.batch_size = batch_size;
+            options.shuffle = shuffle;
+            options.normalize = normalize;
+            options.patience = patience;
+            options.min_delta = min_delta;
+            options.seed = seed;
+            options.on_epoch = on_epoch;
+            return self.fit(x, y, options);
+        },
+        py::arg("x"), py::arg("y"), py::arg("epochs") = 10, py::arg("batch_size") = 32, py::arg("shuffle") = true, py::arg("normalize") = false,
+        py::arg("patience") = 0, py::arg("min_delta") = T(0), py::arg("seed") = 0, py::arg("on_epoch") = py::none(),
+        py::call_guard<py::gil_scoped_release>(),//the whole training loop runs without the gil (on_epoch takes it again)
+        "fit_result ([[double]] x, [[double]] y, ...), trains with mean squared error, on_epoch(epoch, loss) is called after every epoch")
+        .def("forward_async",[](py::object self, std::vector<T> x, bool normalize) {
+            auto [future, complete] = python_future<std::vector<T>>(self);
+            self.cast<const SplineNetLib::nn_t<T>&>().forward_async(std::move(x), normalize, std::move(complete));
+            return future;
+        },
+        py::arg("x"), py::arg("normalize"),"concurrent.futures.Future ([double] x, bool normalize), forward on the library threads without the gil (asyncio.wrap_future makes it awaitable)")
+        .def("compile",&SplineNetLib::nn_t<T>::compile,py::arg("normalize"),"compiled_nn (bool normalize), immutable inference copy of the network")
+        .def("save",[](const SplineNetLib::nn_t<T> &self, const std::string &path) { SplineNetLib::save(self, path); },
+             py::arg("path"),"None (str path), writes all layers to a binary model file")
+        .def_readwrite("layers",&SplineNetLib::nn_t<T>::layers)
+        .def_readwrite("training",&SplineNetLib::nn_t<T>::training)
+        .def_readwrite("activation_budget",&SplineNetLib::nn_t<T>::activation_budget);
+}
+
+
 PYBIND11_MODULE(PySplineNetLib, m) {
-    py::class_<SplineNetLib::spline>(m, "spline")
-        .def(py::init<const std::vector < std::vector < double>>&, const std::vector < std::vector < double>>& >())  // Bind constructor
-        .def("interpolation",&SplineNetLib::spline::interpolation,"None (None), interpolates the spline based on its points")
-        .def("forward",&SplineNetLib::spline::forward,"double (double x), evaluates spline at x (if x in bounds)")
-        .def("backward",&SplineNetLib::spline::backward,"double (double in,double d_y,double out), uses previous input, loss gradient and last output for gradient descent")
-        .def("apply_grad",&SplineNetLib::spline::apply_grad,"None (double lr),apply grad from backward * lr")
-        .def("get_points",&SplineNetLib::spline::get_points,"[[double]] (None),return spline points like [[x0,y0],...,[xn,yn]]")
-        .def("get_params",&SplineNetLib::spline::get_params,"[[double]] (None),return spline parameters/coefficients like [[a0,b0,c0,d0],...,[an,bn,cn,dn]]");
-
-    py::class_<SplineNetLib::layer>(m, "layer")
-        .def(py::init<unsigned int, unsigned int, unsigned int, double>())//in size, out size, detail (num of parameters -2), max (maximum input value that spline processes)
-        .def(py::init<std::vector<std::vector<std::vector<std::vector<double>>>>, std::vector<std::vector<std::vector<std::vector<double>>>> >())
-        .def("interpolate_splines",&SplineNetLib::layer::interpolate_splines,"None (None), calls interpolation on all splines in the layer")
-        .def("forward",py::overload_cast<std::vector<double>, bool>(&SplineNetLib::layer::forward),"[double] ([double] x, bool normalize), forward call for single input sample")
-        .def("forward",py::overload_cast<const std::vector<std::vector<double>> &, bool>(&SplineNetLib::layer::forward),"[[double]] (const [[double]] &x, bool normalize), forward call for batches")
-        .def("backward",py::overload_cast<std::vector<double>,std::vector<double> , bool>(&SplineNetLib::layer::backward),"[double] ([double] x,[double]d_y,bool normalize), takes input x, loss gradient d_y and bool apply_grad,returns propageted loss (applies grad to all splines if True)")
-        .def("backward",py::overload_cast<const std::vector<std::vector<double>> &,std::vector<std::vector<double>> >(&SplineNetLib::layer::backward),"backward but for batches (will always apply gradients)")
-        .def("get_splines",&SplineNetLib::layer::get_splines,"[[SplineNetLib::spline]] (None), returns all splines in the layer")
-        .def_readwrite("lr", &SplineNetLib::layer::lr);
+    //threads used by the batched passes
+    m.def("set_num_threads",&SplineNetLib::set_num_threads,"None (int n), number of threads for batched forward (0 = all cores, 1 = no threads)");
+    m.def("get_num_threads",&SplineNetLib::get_num_threads,"int (None), number of threads for batched forward");
+    //forward_async futures are completed on the pool threads with the gil, so the pool has to finish its tasks while the
+    //interpreter is still alive (a task taking the gil after finalization crashes)
+    py::module_::import("atexit").attr("register")(py::cpp_function([]() {
+        py::gil_scoped_release release; //the drained tasks need the gil
+        SplineNetLib::reset_default_pool();
+    }));
+    m.def("set_parallel",[](bool enabled) { SplineNetLib::parallel = enabled; },"None (bool enabled), run the batched layer backward on several threads");
+    m.def("get_parallel",[]() { return SplineNetLib::parallel; },"bool (None), True if the batched layer backward runs on several threads");
+    //lr scaling of layer.step()
+    py::enum_<SplineNetLib::grad_reduction>(m, "grad_reduction")
+        .value("mean", SplineNetLib::grad_reduction::mean)
+        .value("sum", SplineNetLib::grad_reduction::sum);
+    //update rules of layer.step()
+    py::enum_<SplineNetLib::optimizer_kind>(m, "optimizer_kind")
+        .value("sgd", SplineNetLib::optimizer_kind::sgd)
+        .value("momentum", SplineNetLib::optimizer_kind::momentum)
+        .value("rmsprop", SplineNetLib::optimizer_kind::rmsprop)
+        .value("adam", SplineNetLib::optimizer_kind::adam);
+    //natural cubic or local support b-spline (spline, layer and nn constructors)
+    py::enum_<SplineNetLib::spline_kind>(m, "spline_kind")
+        .value("natural", SplineNetLib::spline_kind::natural)
+        .value("bspline", SplineNetLib::spline_kind::bspline);
+    //what forward does with inputs outside of the spline points (spline.boundary, layer and nn constructors)
+    py::enum_<SplineNetLib::boundary_policy>(m, "boundary_policy")
+        .value("error", SplineNetLib::boundary_policy::error)
+        .value("clamp", SplineNetLib::boundary_policy::clamp)
+        .value("extrapolate", SplineNetLib::boundary_policy::extrapolate);
+    bind_optimizer<double>(m, "optimizer");
+    bind_optimizer<float>(m, "optimizer_f32");
+    //double precision (default) and single precision (_f32) splines and layers
+    bind_spline<double>(m, "spline");
+    bind_spline<float>(m, "spline_f32");
+    bind_layer<double>(m, "layer");
+    bind_layer<float>(m, "layer_f32");
+    bind_lut_layer<double>(m, "lut_layer");
+    bind_lut_layer<float>(m, "lut_layer_f32");
+    bind_compiled_nn<double>(m, "compiled_nn");
+    bind_compiled_nn<float>(m, "compiled_nn_f32");
+    bind_nn<double>(m, "nn", "fit_result");
+    bind_nn<float>(m, "nn_f32", "fit_result_f32");
+    bind_pipeline<double>(m, "nn_pipeline");
+    bind_pipeline<float>(m, "nn_pipeline_f32");
+    bind_batcher<double>(m, "inference_batcher");
+    bind_batcher<float>(m, "inference_batcher_f32");
+    //binary model files (layer.save / nn.save), the _f32 versions read files saved from single precision objects
+    m.def("load_layer",&SplineNetLib::load_layer<double>,py::arg("path"),"layer (str path), reads a layer saved with layer.save");
+    m.def("load_layer_f32",&SplineNetLib::load_layer<float>,py::arg("path"),"layer_f32 (str path), reads a layer saved with layer_f32.save");
+    m.def("load_nn",&SplineNetLib::load_nn<double>,py::arg("path"),"nn (str path), reads a network saved with nn.save");
+    m.def("load_nn_f32",&SplineNetLib::load_nn<float>,py::arg("path"),"nn_f32 (str path), reads a network saved with nn_f32.save");
+    bind_mapped_model<double>(m, "mapped_model");
+    bind_mapped_model<float>(m, "mapped_model_f32");
     //int tensor
     py::class_<SplineNetLib::CTensor<int>>(m, "IntCTensor")
 
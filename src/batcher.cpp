@@ -0,0 +1,109 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#include "../include/SplineNetLib/batcher.hpp"
+
+namespace SplineNetLib {
+
+template<typename T>
+inference_batcher_t<T>::inference_batcher_t(const nn_t<T> &source, bool normalize, size_t _max_batch, std::chrono::microseconds _max_wait)
+    : net(source.compile(normalize)), max_batch(_max_batch), max_wait(_max_wait) {
+    if (max_batch == 0) {
+        throw std::invalid_argument("inference_batcher: max_batch must be at least 1");
+    }
+    dispatcher = std::thread([this]() { dispatch_loop(); });
+}
+
+template<typename T>
+inference_batcher_t<T>::~inference_batcher_t() {
+    {
+        std::lock_guard<std::mutex> lock(requests_mutex);
+        stopping = true;
+    }
+    requests_cv.notify_all();
+    dispatcher.join();
+}
+
+template<typename T>
+std::future<std::vector<T>> inference_batcher_t<T>::submit(std::vector<T> x) {
+    if (x.size() != net.input_size()) {
+        throw std::invalid_argument("submit: x must have the networks input size");
+    }
+    request_t request;
+    request.x = std::move(x);
+    request.arrival = std::chrono::steady_clock::now();
+    std::future<std::vector<T>> result = request.result.get_future();
+    size_t waiting;
+    {
+        std::lock_guard<std::mutex> lock(requests_mutex);
+        requests.push_back(std::move(request));
+        waiting = requests.size();
+    }
+    //the dispatcher only needs to wake up for the first request (deadline starts) and a full batch
+    if (waiting == 1 || waiting >= max_batch) {
+        requests_cv.notify_one();
+    }
+    return result;
+}
+
+template<typename T>
+void inference_batcher_t<T>::dispatch_loop() {
+    std::vector<request_t> batch;
+    batch.reserve(max_batch);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(requests_mutex);
+            requests_cv.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (requests.empty()) {
+                return; //stopping and everything is done
+            }
+            //wait for more requests until the batch is full or the oldest one waited max_wait (no waiting when stopping)
+            auto deadline = requests.front().arrival + max_wait;
+            requests_cv.wait_until(lock, deadline, [this]() { return stopping || requests.size() >= max_batch; });
+            size_t count = std::min(max_batch, requests.size());
+            for (size_t i = 0; i < count; i++) {
+                batch.push_back(std::move(requests.front()));
+                requests.pop_front();
+            }
+        }
+        run_batch(batch);
+        batch.clear();
+    }
+}
+
+template<typename T>
+void inference_batcher_t<T>::run_batch(std::vector<request_t> &batch) {
+    std::vector<std::vector<T>> x(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        x[i] = std::move(batch[i].x);
+    }
+    batches.fetch_add(1);
+    samples.fetch_add(batch.size());
+    try {
+        std::vector<std::vector<T>> y = net.forward(x);
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch[i].result.set_value(std::move(y[i]));
+        }
+    } catch (...) {
+        //one bad sample fails the batched forward, run them one by one so only its own future gets the exception
+        for (size_t i = 0; i < batch.size(); i++) {
+            try {
+                batch[i].result.set_value(net.forward(x[i]));
+            } catch (...) {
+                batch[i].result.set_exception(std::current_exception());
+            }
+        }
+    }
+}
+
+template class inference_batcher_t<float>;
+template class inference_batcher_t<double>;
+
+}//namespace
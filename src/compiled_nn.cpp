@@ -0,0 +1,219 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#include "../include/SplineNetLib/compiled_nn.hpp"
+
+#include <algorithm>
+
+namespace SplineNetLib {
+
+namespace {
+
+//rows start on a cache line
+template<typename T>
+size_t align_row(size_t offset) {
+    constexpr size_t line = 64 / sizeof(T);
+    return (offset + line - 1) / line * line;
+}
+
+//spline::bound_input on flat knots
+template<typename T>
+T bound_input(const T* knots, size_t points, boundary_policy boundary, T x) {
+    if (boundary == boundary_policy::error) {
+        if (!(x <= knots[points - 1])) {
+            print_err("x not in range of spline bounds. bounds : [", knots[0], ",", knots[points - 1], "]");
+            throw std::runtime_error("x out of bounds");
+        }
+        return x;
+    }
+    return std::min(knots[points - 1], std::max(knots[0], x));
+}
+
+//spline::find_segment on flat knots (inv_h != 0 for the direct locator)
+template<typename T>
+size_t find_segment(const T* knots, size_t points, T inv_h, T x) {
+    size_t last = points - 2;
+    if (inv_h != T(0)) {
+        T r = std::min(std::max((x - knots[0]) * inv_h, T(0)), (T)last + T(1));
+        size_t i = (size_t)std::ceil(r);
+        i = (i > 0) ? i - 1 : 0;
+        return (i < last) ? i : last;
+    }
+    const T* base = knots + 1;
+    size_t len = points - 1;
+    while (len > 1) {
+        size_t half = len / 2;
+        base = (base[half - 1] < x) ? base + half : base;
+        len -= half;
+    }
+    size_t i = (size_t)(base - knots) + (*base < x);
+    return (i - 1 < last) ? i - 1 : last;
+}
+
+}//namespace
+
+template<typename T>
+compiled_nn_t<T>::compiled_nn_t(const nn_t<T> &source, bool normalize) : normalized(normalize) {
+    if (source.layers.empty()) {
+        throw std::invalid_argument("compile: network has no layers");
+    }
+    //sizes first so the arena is allocated once
+    size_t size = 0;
+    for (size_t l = 0; l < source.layers.size(); l++) {
+        const layer_t<T> &layer = source.layers[l];
+        layer_plan plan;
+        plan.in_size = layer.input_size();
+        plan.out_size = layer.output_size();
+        plan.points = layer.get_detail() + 2;
+        plan.boundary = layer.get_boundary();
+        plan.normalize = normalize && (l + 1 < source.layers.size());
+        plan.first_row = rows.size();
+        for (size_t i = 0; i < plan.in_size; i++) {
+            std::span<const T> knots = layer.get_spline(i, 0).get_knot_x();
+            bool shared = true;
+            for (size_t j = 0; j < plan.out_size; j++) {
+                std::span<const T> other = layer.get_spline(i, j).get_knot_x();
+                if (other.size() != plan.points) {
+                    throw std::invalid_argument("compile: all splines of a layer must have detail + 2 points");
+                }
+                shared = shared && std::ranges::equal(other, knots);
+            }
+            size = align_row<T>(size);
+            rows.push_back({size, shared, shared ? layer.get_spline(i, 0).uniform_inv_h() : T(0)});
+            size_t spline_size = plan.points + (plan.points - 1) * 4;
+            size += shared ? plan.points + (plan.points - 1) * 4 * plan.out_size : spline_size * plan.out_size;
+        }
+        layers.push_back(plan);
+        max_width = std::max<size_t>(max_width, plan.out_size);
+    }
+
+    arena.assign(size, T(0));
+    for (size_t l = 0; l < layers.size(); l++) {
+        const layer_t<T> &layer = source.layers[l];
+        const layer_plan &plan = layers[l];
+        size_t segments = plan.points - 1;
+        for (size_t i = 0; i < plan.in_size; i++) {
+            const row_plan &r = rows[plan.first_row + i];
+            T* row = &arena[r.offset];
+            if (r.shared) {
+                std::ranges::copy(layer.get_spline(i, 0).get_knot_x(), row);
+                T* packed = row + plan.points;
+                for (size_t j = 0; j < plan.out_size; j++) {
+                    std::span<const T> c = layer.get_spline(i, j).get_coeffs();
+                    //c is [segment][a,b,c,d], the row is [segment][a,b,c,d][out]
+                    for (size_t k = 0; k < c.size(); k++) {
+                        packed[k * plan.out_size + j] = c[k];
+                    }
+                }
+            } else {
+                for (size_t j = 0; j < plan.out_size; j++) {
+                    T* spline = row + j * (plan.points + segments * 4);
+                    std::ranges::copy(layer.get_spline(i, j).get_knot_x(), spline);
+                    std::ranges::copy(layer.get_spline(i, j).get_coeffs(), spline + plan.points);
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+void compiled_nn_t<T>::add_row(const layer_plan &l, const row_plan &r, T x, T* out) const {
+    const T* row = &arena[r.offset];
+    const size_t points = l.points, segments = points - 1;
+    if (!r.shared) {
+        for (size_t j = 0; j < l.out_size; j++) {
+            const T* knots = row + j * (points + segments * 4);
+            T xb = bound_input(knots, points, l.boundary, x);
+            size_t seg = find_segment(knots, points, T(0), xb);
+            const T* p = knots + points + seg * 4;
+            T u = xb - knots[seg];
+            out[j] += p[0] + u * (p[1] + u * (p[2] + u * p[3]));
+            if (l.boundary == boundary_policy::extrapolate) {
+                out[j] += (p[1] + u * (T(2) * p[2] + T(3) * u * p[3])) * (x - xb);
+            }
+        }
+        return;
+    }
+    T xb = bound_input(row, points, l.boundary, x);
+    size_t seg = find_segment(row, points, r.inv_h, xb);
+    T u = xb - row[seg], dx = x - xb;
+    const T* a = row + points + seg * 4 * l.out_size;
+    const T* b = a + l.out_size;
+    const T* c = b + l.out_size;
+    const T* d = c + l.out_size;
+    //same as layer::forward_row, vectorizes over the outputs
+    for (size_t j = 0; j < l.out_size; j++) {
+        out[j] += a[j] + u * (b[j] + u * (c[j] + u * d[j]));
+    }
+    if (l.boundary == boundary_policy::extrapolate) {
+        for (size_t j = 0; j < l.out_size; j++) {
+            out[j] += (b[j] + u * (T(2) * c[j] + T(3) * u * d[j])) * dx;
+        }
+    }
+}
+
+template<typename T>
+void compiled_nn_t<T>::forward_into(std::span<const T> x, std::span<T> out, std::span<T> workspace) const {
+    if (x.size() != input_size() || out.size() != output_size() || workspace.size() < workspace_size()) {
+        throw std::invalid_argument("forward_into: x, out or workspace have the wrong size");
+    }
+    //normalize is folded into the next layer: instead of rewriting the output it divides every input while reading it
+    //(the same division as layer::normalize_output, so the results match nn::forward exactly)
+    const T* in = x.data();
+    T divisor = T(1);
+    for (size_t l = 0; l < layers.size(); l++) {
+        const layer_plan &plan = layers[l];
+        bool last = (l + 1 == layers.size());
+        T* target = last ? out.data() : workspace.data() + (l % 2) * max_width;
+        std::fill(target, target + plan.out_size, T(0));
+        const row_plan* row = &rows[plan.first_row];
+        for (size_t i = 0; i < plan.in_size; i++) {
+            add_row(plan, row[i], in[i] / divisor, target);
+        }
+        divisor = T(1);
+        if (plan.normalize) {
+            T max = *std::max_element(target, target + plan.out_size);
+            divisor = (max != T(0)) ? max : T(1);
+        }
+        in = target;
+    }
+}
+
+template<typename T>
+void compiled_nn_t<T>::forward_into(std::span<const T> x, std::span<T> out) const {
+    thread_local std::vector<T> workspace; //shared by all compiled networks of the same T on this thread
+    if (workspace.size() < workspace_size()) {
+        workspace.resize(workspace_size());
+    }
+    forward_into(x, out, workspace);
+}
+
+template<typename T>
+std::vector<T> compiled_nn_t<T>::forward(const std::vector<T> &x) const {
+    std::vector<T> output(output_size());
+    forward_into(x, output);
+    return output;
+}
+
+template<typename T>
+std::vector<std::vector<T>> compiled_nn_t<T>::forward(const std::vector<std::vector<T>> &x) const {
+    std::vector<std::vector<T>> output(x.size(), std::vector<T>(output_size()));
+    default_pool().parallel_for(x.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++) {
+            forward_into(x[b], output[b]);
+        }
+    });
+    return output;
+}
+
+template class compiled_nn_t<float>;
+template class compiled_nn_t<double>;
+
+}//namespace
@@ -14,8 +14,10 @@
 namespace SplineNetLib {
 
 
-layer::layer(unsigned int _in_size, unsigned int _out_size, unsigned int _detail,double max) {
+template<typename T>
+layer_t<T>::layer_t(unsigned int _in_size, unsigned int _out_size, unsigned int _detail,T max, spline_kind _kind, boundary_policy _boundary) {
 
+    kind=_kind;
     in_size=_in_size;
     out_size=_out_size;
     detail=_detail;
@@ -26,12 +28,12 @@ layer::layer(unsigned int _in_size, unsigned int _out_size, unsigned int _detail
     }
     
     //create zeroed points vector
-    std::vector < std::vector < double>>points(_detail + 2, std::vector < double > (2));
+    std::vector < std::vector < T>>points(_detail + 2, std::vector < T > (2));
     //counter for x coordinate
-    double counter = 0.0;
+    T counter = T(0);
     //increment x value based on number of points so that all x are spaced evenly
     for (unsigned int i = 1; i < _detail+1; i++) {
-        counter += max/((double)_detail+2.0);//increment count
+        counter += max/((T)_detail+T(2));//increment count
         points[i][0] = counter;//assign count to x var
     }
     //maje sure that last point ist exactly max value
@@ -41,19 +43,38 @@ layer::layer(unsigned int _in_size, unsigned int _out_size, unsigned int _detail
     for (size_t i = 0; i < _in_size; i++) {
         for (size_t j = 0; j < _out_size; j++) {
             // Directly assign the splines
-            l_splines[i][j] = spline(
+            l_splines[i][j] = spline_t<T>(
                 points, // points
-                std::vector < std::vector < double>>(_detail + 1, std::vector < double > (4)) // params
+                std::vector < std::vector < T>>(_detail + 1, std::vector < T > (4)), // params
+                _kind
                 );
+            l_splines[i][j].set_boundary(_boundary);
         }
     }
+    boundary = _boundary;
+    
+    //all splines have the same knots so they all share one factorization (b-splines dont need one)
+    if (kind == spline_kind::natural) {
+        std::shared_ptr<const spline_factorization_t<T>> shared = l_splines[0][0].get_factorization();
+        for (size_t i = 0; i < _in_size; i++) {
+            for (size_t j = 0; j < _out_size; j++) {
+                l_splines[i][j].share_factorization(shared);
+            }
+        }
+    }
+    init_packing();
 }
 
 //new
-layer::layer(std::vector < std::vector < std::vector < std::vector < double>>>> points_list,
-             std::vector < std::vector < std::vector < std::vector < double>>>> params_list
+template<typename T>
+layer_t<T>::layer_t(std::vector < std::vector < std::vector < std::vector < T>>>> points_list,
+             std::vector < std::vector < std::vector < std::vector < T>>>> params_list,
+             spline_kind _kind,
+             boundary_policy _boundary
             ){//new
     
+    kind = _kind;
+    boundary = _boundary;
 
     in_size = points_list.size();
     out_size = points_list[0].size();
@@ -74,90 +95,483 @@ layer::layer(std::vector < std::vector < std::vector < std::vector < double>>>>
     for (size_t i = 0; i < in_size; i++) {
         for (size_t j = 0; j < out_size; j++) {
             // Directly assign the unique_ptr returned by spline::create to avoid copy error
-            l_splines[i][j] = spline(points_list[i][j], params_list[i][j]);
+            l_splines[i][j] = spline_t<T>(points_list[i][j], params_list[i][j], _kind);
+            l_splines[i][j].set_boundary(_boundary);
+        }
+    }
+    
+    share_factorizations();
+    init_packing();
+}
+
+template<typename T>
+layer_t<T>::layer_t(unsigned int _in_size, unsigned int _out_size, unsigned int _detail,
+             std::span<const T> knot_x, std::span<const T> knot_y, std::span<const T> coeffs,
+             spline_kind _kind, boundary_policy _boundary) {
+    in_size = _in_size;
+    out_size = _out_size;
+    detail = _detail;
+    kind = _kind;
+    boundary = _boundary;
+    
+    size_t points = (size_t)detail + 2, segments = (size_t)detail + 1, n = (size_t)in_size * out_size;
+    if (n == 0 || knot_x.size() != n * points || knot_y.size() != n * points || coeffs.size() != n * segments * 4) {
+        throw std::invalid_argument("layer: flat knot and coefficient arrays dont match the layer size.");
+    }
+    
+    //one copy per array and spline, no nested vectors
+    l_splines.resize(in_size);
+    for (size_t i = 0; i < in_size; i++) {
+        l_splines[i].reserve(out_size);
+        for (size_t j = 0; j < out_size; j++) {
+            size_t k = i * out_size + j;
+            l_splines[i].emplace_back(knot_x.subspan(k * points, points), knot_y.subspan(k * points, points),
+                                      coeffs.subspan(k * segments * 4, segments * 4), _kind);
+            l_splines[i][j].set_boundary(_boundary);
         }
     }
     
+    share_factorizations();
+    init_packing();
 }
 
-void layer::interpolate_splines() {
+template<typename T>
+void layer_t<T>::share_factorizations() {
+    if (kind != spline_kind::natural) {
+        return; //b-splines dont use a factorization
+    }
+    //share one factorization between all splines with the same knots
+    std::vector<std::shared_ptr<const spline_factorization_t<T>>> factorizations;
+    for (size_t i = 0; i < in_size; i++) {
+        for (size_t j = 0; j < out_size; j++) {
+            std::shared_ptr<const spline_factorization_t<T>> own = l_splines[i][j].get_factorization();
+            bool found = false;
+            for (const auto& shared : factorizations) {
+                if (shared->matches(own->knot_x)) {
+                    l_splines[i][j].share_factorization(shared);
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                factorizations.push_back(own);
+            }
+        }
+    }
+}
+
+template<typename T>
+void layer_t<T>::interpolate_splines() {
+    if (kind == spline_kind::bspline) {
+        //nothing to solve, every spline just recomputes its segments
+        for_rows(true, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                for (spline_t<T> &s : l_splines[i]) {
+                    s.interpolation();
+                }
+            }
+            pack_rows(begin, end);
+        });
+        return;
+    }
+    
+    //group the splines by their (shared) factorization, every group is solved at once
+    std::vector<std::shared_ptr<const spline_factorization_t<T>>> factorizations;
+    std::vector<std::vector<spline_t<T>*>> groups;
     for (size_t i = 0; i < l_splines.size(); ++i) {
         for (size_t j = 0; j < l_splines[i].size(); ++j) {
-            l_splines[i][j].interpolation(); //imterpolate all splines in layer
+            std::shared_ptr<const spline_factorization_t<T>> f = l_splines[i][j].get_factorization();
+            size_t g = 0;
+            while (g < factorizations.size() && factorizations[g] != f) {
+                g++;
+            }
+            if (g == factorizations.size()) {
+                factorizations.push_back(f);
+                groups.emplace_back();
+            }
+            groups[g].push_back(&l_splines[i][j]);
+        }
+    }
+    
+    //groups are split into pieces of row_grain inputs (whole groups if row_grain is 0) that can be solved in parallel
+    size_t piece_size = split_rows() ? (size_t)row_grain * out_size : (size_t)-1;
+    std::vector<std::vector<spline_t<T>*>> pieces;
+    std::vector<size_t> piece_group;
+    for (size_t g = 0; g < groups.size(); g++) {
+        for (size_t begin = 0; begin < groups[g].size(); begin += std::min(piece_size, groups[g].size() - begin)) {
+            size_t end = begin + std::min(piece_size, groups[g].size() - begin);
+            pieces.emplace_back(groups[g].begin() + begin, groups[g].begin() + end);
+            piece_group.push_back(g);
         }
     }
+    
+    auto solve = [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; p++) {
+            if (pieces[p].size() == 1) {
+                pieces[p][0]->interpolation(); //nothing to vectorize over
+            } else {
+                interpolate_group(*factorizations[piece_group[p]], pieces[p]);
+            }
+        }
+    };
+    if (split_rows() && pieces.size() > 1) {
+        default_pool().parallel_for(pieces.size(), 1, solve);
+    } else {
+        solve(0, pieces.size());
+    }
+    for_rows(true, [&](size_t begin, size_t end) {
+        pack_rows(begin, end);
+    });
 }
 
+template<typename T>
+void layer_t<T>::interpolate_group(const spline_factorization_t<T> &f, const std::vector<spline_t<T>*> &group) {
+    //same algorithm as spline::interpolation but for all splines in the group at once, the buffers are knot major
+    //([knot][spline]) so every inner loop runs over the splines with one simd lane per spline
+    const size_t S = group.size();
+    const size_t n = f.h.size(); // Number of intervals
+    
+    aligned_vector<T> y((n + 1) * S), c((n + 1) * S);
+    for (size_t s = 0; s < S; s++) {
+        const aligned_vector<T>& knot_y = group[s]->knot_y;
+        for (size_t k = 0; k <= n; k++) {
+            y[k * S + s] = knot_y[k];
+        }
+    }
+    
+    // Forward substitution (z is stored in c, z[0] = 0)
+    for (size_t s = 0; s < S; s++) {
+        c[s] = T(0);
+    }
+    for (size_t i = 1; i < n; ++i) {
+        const T* y_prev = &y[(i - 1) * S];
+        const T* y_i = &y[i * S];
+        const T* y_next = &y[(i + 1) * S];
+        const T* z_prev = &c[(i - 1) * S];
+        T* z_i = &c[i * S];
+        const T w_next = T(3) * f.inv_h[i], w_prev = T(3) * f.inv_h[i - 1], h_prev = f.h[i - 1], inv_l = f.inv_l[i];
+        for (size_t s = 0; s < S; s++) {
+            T alpha = (y_next[s] - y_i[s]) * w_next - (y_i[s] - y_prev[s]) * w_prev;
+            z_i[s] = (alpha - h_prev * z_prev[s]) * inv_l;
+        }
+    }
+    
+    // Back substitution for c (natural spline conditions c[n] = 0)
+    for (size_t s = 0; s < S; s++) {
+        c[n * S + s] = T(0);
+    }
+    for (size_t j = n; j-- > 0;) {
+        const T* c_next = &c[(j + 1) * S];
+        T* c_j = &c[j * S];
+        const T mu = f.mu[j];
+        for (size_t s = 0; s < S; s++) {
+            c_j[s] = c_j[s] - mu * c_next[s];
+        }
+    }
+    
+    //write the a,b,c,d coefficients back to the splines
+    for (size_t s = 0; s < S; s++) {
+        T* p = group[s]->coeffs.data();
+        for (size_t j = 0; j < n; j++) {
+            T y_j = y[j * S + s], y_next = y[(j + 1) * S + s];
+            T c_j = c[j * S + s], c_next = c[(j + 1) * S + s];
+            p[j * 4] = y_j;
+            p[j * 4 + 1] = (y_next - y_j) * f.inv_h[j] - f.h[j] * (c_next + T(2) * c_j) / T(3);
+            p[j * 4 + 2] = c_j;
+            p[j * 4 + 3] = (c_next - c_j) * f.inv_h[j] / T(3);
+        }
+    }
+}
 
-std::vector < double > layer::forward(std::vector < double> x,bool normalize) {
+
+template<typename T>
+std::vector < T > layer_t<T>::forward(std::vector < T> x,bool normalize) {
     
     //std::cout<<"layer fwd call\n";
+    //checked here for both paths (the training path reads x directly)
+    if (x.size() != in_size) {
+        throw std::invalid_argument("forward: x must have the layers input size");
+    }
     // Initialize output with zeros
-    std::vector < double > output(out_size, 0.0);
+    std::vector < T > output(out_size, T(0));
 /*
     // Debug: Print the input vector
     std::cout << "Input vector x: ";
-    for (double val : x) {
+    for (T val : x) {
         std::cout << val << " ";
     }
     std::cout << std::endl;
 */
+    if (training) {
+        //same as forward_into but also records segments and outputs for backward
+        reserve_tape(1);
+        record_sample(x, 0, output.data(), true);
+    }
+    else {
+        forward_into(x, output, false);
+    }
+    if (normalize){
+        normalize_output(output);
+    }
+    last_output=output;
+
+    return output;
+}
+
+template<typename T>
+void layer_t<T>::init_packing() {
+    //grad of spline (i,j) starts at grad_offset[i*out+j] in the flat per chunk gradient buffers of backward_parallel
+    grad_offset.assign((size_t)in_size * out_size + 1, 0);
+    for (size_t k = 0; k < (size_t)in_size * out_size; k++) {
+        grad_offset[k + 1] = grad_offset[k] + l_splines[k / out_size][k % out_size].grad.size();
+    }
+    
+    packed_offset.assign(in_size, not_packed);
+    size_t size = 0;
     for (size_t i = 0; i < in_size; i++) {
+        bool shared = out_size > 0;
+        for (size_t j = 1; shared && j < out_size; j++) {
+            shared = (l_splines[i][j].knot_x == l_splines[i][0].knot_x);
+        }
+        if (shared) {
+            packed_offset[i] = size;
+            size += l_splines[i][0].coeffs.size() * out_size;
+        }
+    }
+    packed.assign(size, T(0));
+    pack_coefficients();
+}
+
+template<typename T>
+void layer_t<T>::pack_rows(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        if (packed_offset[i] == not_packed) {
+            continue;
+        }
+        T* row = &packed[packed_offset[i]];
         for (size_t j = 0; j < out_size; j++) {
-            // Get the spline value for input x[i]
-            double spline_output = l_splines[i][j].forward(x[i]);//in future rested old cached outputs first before fwd pass
+            const aligned_vector<T> &c = l_splines[i][j].coeffs;
+            //c is [segment][a,b,c,d], packed is [segment][a,b,c,d][out]
+            for (size_t k = 0; k < c.size(); k++) {
+                row[k * out_size + j] = c[k];
+            }
+        }
+    }
+}
 
-            // sum the output from this spline into the output vector
-            output[j] += spline_output;
-/*
-            // Debug: Print the output from the current spline
-            std::cout << "Spline[" << i << "][" << j << "] output for x[" << i << "]: " << spline_output << std::endl;
-*/
+template<typename T>
+void layer_t<T>::set_boundary(boundary_policy policy) {
+    boundary = policy;
+    for (std::vector<spline_t<T>> &row : l_splines) {
+        for (spline_t<T> &s : row) {
+            s.set_boundary(policy);
         }
     }
-    /*
-    // Debug: Print the final output vector
-    std::cout << "Final output vector: ";
-    for (double val : output) {
-        std::cout << val << " ";
+}
+
+template<typename T>
+size_t layer_t<T>::locate_packed(size_t i, T x, T &u, T &dx) const {
+    const spline_t<T> &s = l_splines[i][0];
+    T xb = s.bound_input(x); //same policy for all splines of the layer
+    size_t seg = s.find_segment(xb);
+    u = xb - s.knot_x[seg];
+    dx = x - xb;
+    return seg;
+}
+
+template<typename T>
+void layer_t<T>::forward_row(size_t i, T x, T* out) const {
+    if (packed_offset[i] == not_packed) {
+        for (size_t j = 0; j < out_size; j++) {
+            out[j] += l_splines[i][j].forward(x);
+        }
+        return;
     }
-    std::cout << std::endl;
-*/
-    if (normalize){
-        double max=output[0];
-        for (double x:output){
-            max=(max<x) ? x:max;
+    T u, dx;
+    size_t seg = locate_packed(i, x, u, dx);
+    const T* a = &packed[packed_offset[i] + seg * 4 * out_size];
+    const T* b = a + out_size;
+    const T* c = b + out_size;
+    const T* d = c + out_size;
+    //same horner form as spline::forward, vectorizes over the outputs
+    for (size_t j = 0; j < out_size; j++) {
+        out[j] += a[j] + u * (b[j] + u * (c[j] + u * d[j]));
+    }
+    if (boundary == boundary_policy::extrapolate) {
+        //dx is 0 inside the knots
+        for (size_t j = 0; j < out_size; j++) {
+            out[j] += (b[j] + u * (T(2) * c[j] + T(3) * u * d[j])) * dx;
         }
-        if (max!=0){
-            for (size_t i=0;i<output.size();i++){
-                output[i]/=max;
+    }
+}
+
+template<typename T>
+void layer_t<T>::forward_into(std::span<const T> x, std::span<T> out, bool normalize) const {
+    if (x.size() != in_size || out.size() != out_size) {
+        throw std::invalid_argument("forward_into: x must have the layers input size and out its output size");
+    }
+    std::fill(out.begin(), out.end(), T(0));
+    if (split_rows()) {
+        //every chunk of rows sums into its own partial output, the partials are added in chunk order
+        size_t num_chunks = (in_size + row_grain - 1) / row_grain;
+        std::vector<T> partial(num_chunks * out_size, T(0));
+        default_pool().parallel_for(in_size, row_grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                forward_row(i, x[i], &partial[(i / row_grain) * out_size]);
+            }
+        });
+        for (size_t c = 0; c < num_chunks; c++) {
+            for (size_t j = 0; j < out_size; j++) {
+                out[j] += partial[c * out_size + j];
             }
         }
+    } else {
+        for (size_t i = 0; i < in_size; i++) {
+            forward_row(i, x[i], out.data());
+        }
     }
-    last_output=output;
+    if (normalize) {
+        normalize_output(out);
+    }
+}
 
-    return output;
+template<typename T>
+void layer_t<T>::forward_samples(const std::vector<std::vector<T>> &x, size_t begin, size_t end, bool normalize, std::vector<std::vector<T>> &output) {
+    if (training) {
+        //record every sample so the batch backward can use the tape
+        for (size_t b = begin; b < end; b++) {
+            record_sample(x[b], b, output[b].data());
+        }
+    }
+    else {
+        //evaluate every spline on all samples of the chunk at once (input column i of the chunk -> spline_outputs)
+        size_t n = end - begin;
+        std::vector<T> x_column(n), spline_outputs(n);
+        for (size_t i = 0; i < in_size; i++) {
+            if (packed_offset[i] != not_packed && out_size >= packed_batch_min_outputs) {
+                //wide layer, one segment search per sample and input is cheaper than one per spline
+                for (size_t b = begin; b < end; b++) {
+                    forward_row(i, x[b][i], output[b].data());
+                }
+                continue;
+            }
+            for (size_t b = 0; b < n; b++) {
+                x_column[b] = x[begin + b][i];
+            }
+            for (size_t j = 0; j < out_size; j++) {
+                l_splines[i][j].forward_batch(x_column.data(), spline_outputs.data(), n);
+                for (size_t b = 0; b < n; b++) {
+                    output[begin + b][j] += spline_outputs[b];
+                }
+            }
+        }
+    }
+    
+    if (normalize) {
+        for (size_t b = begin; b < end; b++) {
+            normalize_output(output[b]);
+        }
+    }
 }
 
-std::vector<std::vector<double>> layer::forward(const std::vector<std::vector<double>> &x, bool normalize) {
+template<typename T>
+std::vector<std::vector<T>> layer_t<T>::forward(const std::vector<std::vector<T>> &x, bool normalize) {
+    size_t batch_size = x.size();
     // Initialize output with zeros
-    std::vector<std::vector<double>> output(x.size(), std::vector<double>(out_size, 0.0));
+    std::vector<std::vector<T>> output(batch_size, std::vector<T>(out_size, T(0)));
+    if (batch_size == 0) {
+        return output;
+    }
+    for (const std::vector<T> &sample : x) {
+        if (sample.size() != in_size) {
+            throw std::invalid_argument("forward: every sample must have the layers input size");
+        }
+    }
     
-    //call single input method for all batches
-    //in future create threads to parallelize this process on multi core cpus
-    for (size_t b = 0; b < x.size(); b++) {
-        output[b] = this->forward(x[b],normalize);
+    if (training) {
+        reserve_tape(batch_size); //sized before the workers write their rows
     }
+    //split the batch into chunks of grain samples that are processed in parallel
+    default_pool().parallel_for(batch_size, grain, [&](size_t begin, size_t end) {
+        forward_samples(x, begin, end, normalize, output);
+    });
+    
+    //same as calling the single sample forward for every sample
+    last_output = output[batch_size - 1];
     
     return output;
 }
 
+template<typename T>
+void layer_t<T>::normalize_output(std::span<T> output) {
+    T max=output[0];
+    for (T x:output){
+        max=(max<x) ? x:max;
+    }
+    if (max!=0){
+        for (size_t i=0;i<output.size();i++){
+            output[i]/=max;
+        }
+    }
+}
+
 
-std::vector < double > layer::backward(std::vector < double > x, std::vector < double > d_y, bool apply) {
+template<typename T>
+std::vector < T > layer_t<T>::backward(std::vector < T > x, std::vector < T > d_y, bool apply) {
 
-    std::vector < double > out(in_size, 0.0);
-    std::vector < std::vector < double>> spline_outputs(out_size, std::vector < double > (in_size));
-    std::vector < double > total_outputs(out_size, 0.0);
+    if (apply && optimizer.kind != optimizer_kind::sgd) {
+        //the optimizer state is per layer so the update goes through step
+        std::vector<T> out = backward(x, d_y, false);
+        step();
+        return out;
+    }
+    
+    std::vector < T > out(in_size, T(0));
+    bool taped = training && tape.batch_size == 1 && tape_matches(x, 0);
+    
+    if (split_rows()) {
+        //every input row owns its splines and out[i], so the rows run in parallel without locks
+        size_t n = (size_t)in_size * out_size;
+        std::vector<uint32_t> segments;
+        std::vector<T> offsets, outputs, totals;
+        if (!taped) {
+            segments.resize(n);
+            offsets.resize(n);
+            outputs.resize(n);
+            totals.resize(out_size);
+            evaluate_sample(x.data(), segments.data(), offsets.data(), outputs.data(), totals.data(), true);
+        }
+        for_rows(true, [&](size_t begin, size_t end) {
+            if (taped) {
+                backward_rows(tape.segments.data(), tape.offsets.data(), tape.outputs.data(), tape.totals.data(), d_y, begin, end, apply, out.data());
+            } else {
+                backward_rows(segments.data(), offsets.data(), outputs.data(), totals.data(), d_y, begin, end, apply, out.data());
+            }
+            if (apply) {
+                pack_rows(begin, end);
+            }
+        });
+        if (apply) {
+            clear_tape();
+        } else {
+            accumulated_samples++;
+        }
+        return out;
+    }
+    
+    if (taped) {
+        backward_taped(d_y, 0, apply, out.data());
+        if (apply) {
+            clear_tape();//splines changed so the recorded outputs are outdated
+            pack_coefficients();
+        } else {
+            accumulated_samples++;
+        }
+        return out;
+    }
+    
+    std::vector < std::vector < T>> spline_outputs(out_size, std::vector < T > (in_size));
+    std::vector < T > total_outputs(out_size, T(0));
 
     // Compute spline outputs and sum them up like in forward (cant use forward bc i need both outputs)
     for (size_t j = 0; j < out_size; j++) {
@@ -170,18 +584,18 @@ std::vector < double > layer::backward(std::vector < double > x, std::vector < d
     // Now calculate the gradients based on individual spline contribution
     for (size_t i = 0; i < in_size; i++) {
         for (size_t j = 0; j < out_size; j++) {
-            double spline_output = spline_outputs[j][i];
-            double total_output = total_outputs[j];
+            T spline_output = spline_outputs[j][i];
+            T total_output = total_outputs[j];
 
             // compute the contribution of each spline
-            double contribution_ratio = 1;//default to 1 for now (better to 0 when points[i][1] -> y is initialized to !=0)
+            T contribution_ratio = 1;//default to 1 for now (better to 0 when points[i][1] -> y is initialized to !=0)
 
-            if (total_output != 0.0) {
+            if (total_output != T(0)) {
                 contribution_ratio = spline_output / total_output;
             }
 
             // The gradient for this spline is the total gradient scaled by its contribution to the output sum
-            double adjusted_gradient = d_y[j] * contribution_ratio;
+            T adjusted_gradient = d_y[j] * contribution_ratio;
             
             //new
             // calculate the gradient of the activation and adjust spline gradient based on it
@@ -196,68 +610,268 @@ std::vector < double > layer::backward(std::vector < double > x, std::vector < d
             }
         }
     }
+    if (apply) {
+        pack_coefficients();
+    } else {
+        accumulated_samples++;//grad is applied later by step()
+    }
 
     return out;
 }
 
-std::vector<std::vector<double>> layer::backward(const std::vector<std::vector<double>> &x,std::vector<std::vector<double>> d_y) {
+template<typename T>
+std::vector<std::vector<T>> layer_t<T>::backward(const std::vector<std::vector<T>> &x,std::vector<std::vector<T>> d_y) {
     
     size_t batch_size = x.size();
-    std::vector < std::vector <double>> out(x.size(),std::vector<double> (in_size, 0.0));
+    std::vector < std::vector <T>> out(x.size(),std::vector<T> (in_size, T(0)));
+    
+    //use the spline outputs of the recorded forward pass if there is one for these inputs
+    bool taped = training && tape.batch_size == batch_size;
+    for (size_t b = 0; taped && b < batch_size; b++) {
+        taped = tape_matches(x[b], b);
+    }
     
     if (parallel) {
-        std::cout << "this function (layer parallel backward) was removed because of faulty behaviour. Please set parallel to false\n";
-/*
-        unsigned int max_threads = std::thread::hardware_concurrency();
-        if (max_threads == 0) max_threads = 2;
-        std::vector<std::thread> threads;
-        std::mutex out_mutex;
-        unsigned int active_threads = 0;
-        
+        //samples are split into chunks of grain that accumulate into private grad buffers (see backward_parallel)
+        backward_parallel(x, d_y, taped, out);
+    }
+    else {
+        //accumulate the gradients of all samples (splines dont change during the batch), then apply them once
         for (size_t b = 0; b < batch_size; b++) {
-            threads.emplace_back([&, b]() {//create thread
-                std::vector<double> temp = this->backward(x[b], d_y[b], false);
-        
-                std::lock_guard<std::mutex> lock(out_mutex);
+            if (taped) {
+                backward_taped(d_y[b], b, false, out[b].data());
+                accumulated_samples++;
+            } else {
+                std::vector<T> temp = this->backward(x[b], d_y[b], false);
                 for (size_t i = 0; i < temp.size(); i++) {
-                    out[b][i] += temp[i];
+                    out[b][i] += temp[i];//accumulated grad with respect to the the inputs (not like grad in spline)
                 }
-            });
-        
-            // Limit the number of concurrent threads
-            if (++active_threads >= max_threads) {
-                for (auto &thread : threads) {
-                    thread.join();
+            }
+        }
+    }
+    step();
+    return out;
+}
+
+template<typename T>
+void layer_t<T>::step() {
+    //the gradient (not lr) is averaged so adam/rmsprop see the mean gradient
+    T grad_scale = T(1);
+    if (reduction == grad_reduction::mean && accumulated_samples > 1) {
+        grad_scale = T(1) / (T)accumulated_samples;
+    }
+    size_t n = (size_t)in_size * out_size;
+    if (kind == spline_kind::bspline && optimizer.kind == optimizer_kind::sgd) {
+        //sparse update, every b-spline only recomputes the segments around the control points that got a grad
+        for_rows(true, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                for (spline_t<T> &s : l_splines[i]) {
+                    s.apply_grad(lr * grad_scale);
                 }
-                threads.clear();
-                active_threads = 0;
             }
+            pack_rows(begin, end);
+        });
+        accumulated_samples = 0;
+        clear_tape();
+        return;
+    }
+    if (optimizer.kind != optimizer_kind::sgd) {
+        if (optimizer_m.size() != grad_offset[n]) {
+            optimizer_m.assign(grad_offset[n], T(0));
+            optimizer_v.assign(grad_offset[n], T(0));
         }
-        
-        // Join remaining threads
-        for (auto &thread : threads) {
-            thread.join();
+        optimizer_steps++;
+    }
+    //one optimizer_update call per spline (y, grad and the optimizer state of the spline in one pass), the knot y values and
+    //grads live in the splines so there is no single flat array of the whole layer to update with one call
+    for (size_t k = 0; k < n; k++) {
+        spline_t<T> &s = l_splines[k / out_size][k % out_size];
+        T* m = optimizer_m.empty() ? nullptr : &optimizer_m[grad_offset[k]];
+        T* v = optimizer_v.empty() ? nullptr : &optimizer_v[grad_offset[k]];
+        optimizer_update(optimizer, lr, grad_scale, optimizer_steps, s.knot_y.data(), s.grad.data(), m, v, s.grad.size());
+    }
+    //one bulk interpolation instead of one per spline and sample
+    interpolate_splines();
+    accumulated_samples = 0;
+    clear_tape();
+}
+
+template<typename T>
+void layer_t<T>::reset_optimizer() {
+    std::fill(optimizer_m.begin(), optimizer_m.end(), T(0));
+    std::fill(optimizer_v.begin(), optimizer_v.end(), T(0));
+    optimizer_steps = 0;
+}
+
+template<typename T>
+void layer_t<T>::reserve_tape(size_t batch_size) {
+    size_t n = batch_size * in_size * out_size;
+    tape.batch_size = batch_size;
+    tape.inputs.resize(batch_size * in_size);
+    tape.segments.resize(n);
+    tape.offsets.resize(n);
+    tape.outputs.resize(n);
+    tape.totals.resize(batch_size * out_size);
+}
+
+template<typename T>
+void layer_t<T>::evaluate_sample(const T* x, uint32_t* segments, T* offsets, T* outputs, T* totals, bool split) const {
+    for_rows(split, [&](size_t begin, size_t end) {
+        evaluate_rows(x, begin, end, segments, offsets, outputs);
+    });
+    //sum over the inputs for every output
+    std::fill(totals, totals + out_size, T(0));
+    for (size_t i = 0; i < in_size; i++) {
+        for (size_t j = 0; j < out_size; j++) {
+            totals[j] += outputs[i * out_size + j];
         }
-*/
     }
-    else {
-        //calculate gradients for all splines over every batch (grad will be accumulated in spline)
-        for (size_t b = 0; b < x.size(); b++) {
-            std::vector<double> temp = this->backward(x[b],d_y[b], true); //remove {0} once y was removed from func decleration
-            for (size_t i = 0; i < temp.size(); i++) {
-                out[b][i] += temp[i];//accumulated grad with respect to the the inputs (not like grad in spline)
+}
+
+template<typename T>
+void layer_t<T>::evaluate_rows(const T* x, size_t begin, size_t end, uint32_t* segments, T* offsets, T* outputs) const {
+    for (size_t i = begin; i < end; i++) {
+        size_t k = i * out_size;
+        if (packed_offset[i] == not_packed) {
+            for (size_t j = 0; j < out_size; j++) {
+                outputs[k + j] = l_splines[i][j].forward_segment(x[i], segments[k + j], offsets[k + j]);
+            }
+            continue;
+        }
+        //all splines of input i share the segment
+        T u, dx;
+        size_t seg = locate_packed(i, x[i], u, dx);
+        const T* a = &packed[packed_offset[i] + seg * 4 * out_size];
+        for (size_t j = 0; j < out_size; j++) {
+            segments[k + j] = (uint32_t)seg;
+            offsets[k + j] = u;
+            outputs[k + j] = a[j] + u * (a[j + out_size] + u * (a[j + 2 * out_size] + u * a[j + 3 * out_size]));
+        }
+        if (boundary == boundary_policy::extrapolate) {
+            for (size_t j = 0; j < out_size; j++) {
+                outputs[k + j] += (a[j + out_size] + u * (T(2) * a[j + 2 * out_size] + T(3) * u * a[j + 3 * out_size])) * dx;
             }
         }
     }
-    /*
+}
+
+template<typename T>
+void layer_t<T>::record_sample(const std::vector<T> &x, size_t b, T* output, bool split) {
+    size_t n = (size_t)in_size * out_size;
+    T* totals = &tape.totals[b * out_size];
+    std::copy(x.begin(), x.begin() + in_size, tape.inputs.begin() + b * in_size);
+    evaluate_sample(x.data(), &tape.segments[b * n], &tape.offsets[b * n], &tape.outputs[b * n], totals, split);
+    for (size_t j = 0; j < out_size; j++) {
+        output[j] += totals[j];
+    }
+}
+
+template<typename T>
+void layer_t<T>::accumulate_sample(const uint32_t* segments, const T* offsets, const T* outputs, const T* totals, const std::vector<T> &d_y, T* grads, T* out) const {
+    //same as backward_taped but the spline grads go to grads (laid out like grad_offset) instead of the splines
+    uint32_t index[4];
+    T weight[4];
     for (size_t i = 0; i < in_size; i++) {
         for (size_t j = 0; j < out_size; j++) {
-            //std::cout <<"in layer bwd apply_grad\n";
-            l_splines[i][j].apply_grad(lr/x.size());//adjust spline params based on grad/batch_size
+            size_t k = i * out_size + j;
+            T contribution_ratio = 1;
+            if (totals[j] != T(0)) {
+                contribution_ratio = outputs[k] / totals[j];
+            }
+            T adjusted_gradient = d_y[j] * contribution_ratio;
+            uint32_t num_targets = l_splines[i][j].grad_targets(segments[k], offsets[k], index, weight);
+            for (uint32_t t = 0; t < num_targets; t++) {
+                grads[grad_offset[k] + index[t]] += weight[t] * adjusted_gradient;
+            }
+            out[i] += adjusted_gradient;
         }
     }
-    */
-    return out;
 }
 
+template<typename T>
+void layer_t<T>::backward_parallel(const std::vector<std::vector<T>> &x, const std::vector<std::vector<T>> &d_y, bool taped, std::vector<std::vector<T>> &out) {
+    size_t batch_size = x.size();
+    size_t n = (size_t)in_size * out_size;
+    size_t grain_size = std::max<size_t>(grain, 1);
+    size_t num_chunks = (batch_size + grain_size - 1) / grain_size;
+    //one private gradient buffer per chunk (chunks only depend on grain, so the result doesnt depend on the number of threads)
+    std::vector<T> chunk_grads(num_chunks * grad_offset[n], T(0));
+    
+    default_pool().parallel_for(batch_size, grain_size, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> segments;
+        std::vector<T> offsets, outputs, totals;
+        if (!taped) {
+            segments.resize(n);
+            offsets.resize(n);
+            outputs.resize(n);
+            totals.resize(out_size);
+        }
+        for (size_t b = begin; b < end; b++) {
+            //without threads parallel_for runs everything at once, the buffer still depends only on b
+            T* grads = &chunk_grads[(b / grain_size) * grad_offset[n]];
+            if (taped) {
+                accumulate_sample(&tape.segments[b * n], &tape.offsets[b * n], &tape.outputs[b * n], &tape.totals[b * out_size], d_y[b], grads, out[b].data());
+            } else {
+                evaluate_sample(x[b].data(), segments.data(), offsets.data(), outputs.data(), totals.data());
+                accumulate_sample(segments.data(), offsets.data(), outputs.data(), totals.data(), d_y[b], grads, out[b].data());
+            }
+        }
+    });
+    
+    //reduce the chunk buffers into the splines, always in chunk order so the sum is deterministic
+    default_pool().parallel_for(in_size, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            for (size_t j = 0; j < out_size; j++) {
+                size_t k = i * out_size + j;
+                aligned_vector<T> &grad = l_splines[i][j].grad;
+                for (size_t c = 0; c < num_chunks; c++) {
+                    const T* grads = &chunk_grads[c * grad_offset[n] + grad_offset[k]];
+                    for (size_t p = 0; p < grad.size(); p++) {
+                        grad[p] += grads[p];
+                    }
+                }
+            }
+        }
+    });
+    accumulated_samples += batch_size;
+}
+
+template<typename T>
+bool layer_t<T>::tape_matches(const std::vector<T> &x, size_t b) const {
+    if (x.size() != in_size) {
+        return false;
+    }
+    return std::equal(x.begin(), x.end(), tape.inputs.begin() + b * in_size);
+}
+
+template<typename T>
+void layer_t<T>::backward_taped(const std::vector<T> &d_y, size_t b, bool apply, T* out) {
+    size_t n = (size_t)in_size * out_size;
+    backward_rows(&tape.segments[b * n], &tape.offsets[b * n], &tape.outputs[b * n], &tape.totals[b * out_size], d_y, 0, in_size, apply, out);
+}
+
+template<typename T>
+void layer_t<T>::backward_rows(const uint32_t* segments, const T* offsets, const T* outputs, const T* totals, const std::vector<T> &d_y, size_t begin, size_t end, bool apply, T* out) {
+    //same as the recomputing backward, the spline outputs and segments just come from the tape (or evaluate_sample)
+    for (size_t i = begin; i < end; i++) {
+        for (size_t j = 0; j < out_size; j++) {
+            size_t k = i * out_size + j;
+            T contribution_ratio = 1;
+            if (totals[j] != T(0)) {
+                contribution_ratio = outputs[k] / totals[j];
+            }
+            T adjusted_gradient = d_y[j] * contribution_ratio;
+            
+            l_splines[i][j].accumulate_grad(segments[k], offsets[k], adjusted_gradient);
+            out[i] += adjusted_gradient;
+            if (apply) {
+                l_splines[i][j].apply_grad(lr);
+            }
+        }
+    }
+}
+
+template class layer_t<float>;
+template class layer_t<double>;
+
 }//namespace
\ No newline at end of file
@@ -0,0 +1,254 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#include "../include/SplineNetLib/lut_layer.hpp"
+
+#include <limits>
+
+namespace SplineNetLib {
+
+template<typename T>
+lut_layer_t<T>::lut_layer_t(const layer_t<T> &source, size_t grid_size, bool quantize) {
+    if (grid_size < 2) {
+        throw std::invalid_argument("lut_layer: grid_size must be at least 2.");
+    }
+    in_size = source.in_size;
+    out_size = source.out_size;
+    grid = grid_size;
+    quantized = quantize;
+    boundary = source.boundary;
+
+    x_lo.resize(in_size);
+    x_hi.resize(in_size);
+    inv_step.resize(in_size);
+    const size_t row = grid * 2 * out_size; //table size of one input
+    table.assign(in_size * row, T(0));
+    if (quantize) {
+        table_q.assign(in_size * row, 0);
+        scales.assign((size_t)in_size * 2 * out_size, T(0));
+    }
+    std::vector<T> spline_error((size_t)in_size * out_size, T(0)); //[in][out]
+
+    //every input row is sampled (and bounded) on its own
+    default_pool().parallel_for(in_size, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const std::vector<spline_t<T>> &splines = source.l_splines[i];
+            //range where all splines of input i are defined
+            T lo = splines[0].min_x(), hi = splines[0].max_x();
+            for (const spline_t<T> &s : splines) {
+                lo = std::max(lo, s.min_x());
+                hi = std::min(hi, s.max_x());
+            }
+            T step = (hi - lo) / (T)(grid - 1);
+            x_lo[i] = lo;
+            x_hi[i] = hi;
+            inv_step[i] = (step > T(0)) ? T(1) / step : T(0);
+
+            T* values = &table[i * row];
+            for (size_t g = 0; g < grid; g++) {
+                T x = (g == grid - 1) ? hi : lo + (T)g * step;
+                for (size_t j = 0; j < out_size; j++) {
+                    values[g * 2 * out_size + j] = splines[j].forward(x);
+                }
+            }
+            //delta of the last grid point stays 0 (it is only reached with t = 0)
+            for (size_t g = 0; g + 1 < grid; g++) {
+                for (size_t j = 0; j < out_size; j++) {
+                    values[g * 2 * out_size + out_size + j] = values[(g + 1) * 2 * out_size + j] - values[g * 2 * out_size + j];
+                }
+            }
+
+            if (quantize) {
+                //symmetric scale per spline for the values and the deltas
+                T* s = &scales[i * 2 * out_size];
+                for (size_t g = 0; g < grid; g++) {
+                    for (size_t k = 0; k < 2 * out_size; k++) {
+                        s[k] = std::max(s[k], std::fabs(values[g * 2 * out_size + k]));
+                    }
+                }
+                for (size_t k = 0; k < 2 * out_size; k++) {
+                    s[k] /= T(32767);
+                }
+                for (size_t g = 0; g < grid; g++) {
+                    for (size_t k = 0; k < 2 * out_size; k++) {
+                        T v = values[g * 2 * out_size + k];
+                        table_q[i * row + g * 2 * out_size + k] = (s[k] > T(0)) ? (int16_t)std::lround(v / s[k]) : int16_t(0);
+                    }
+                }
+            }
+
+            //error bound of every spline (i,j), inside a cell the table is a line and the spline a cubic per knot segment,
+            //so the largest difference on every piece is found exactly at its ends or where the derivatives are equal
+            const T eps = std::numeric_limits<T>::epsilon();
+            for (size_t j = 0; j < out_size; j++) {
+                std::span<const T> kx = splines[j].get_knot_x();
+                std::span<const T> c = splines[j].get_coeffs();
+                const size_t last = kx.size() - 2;
+                T e = T(0), magnitude = T(0);
+                for (size_t g = 0; g + 1 < grid; g++) {
+                    T a = lo + (T)g * step;
+                    T b = (g + 2 == grid) ? hi : lo + (T)(g + 1) * step;
+                    T v = entry(i, g, j, T(0));
+                    T slope = (entry(i, g, j, T(1)) - v) * inv_step[i];
+                    magnitude = std::max(magnitude, std::fabs(v) + T(2) * std::fabs(slope * step) * (T)grid);
+                    //first segment that reaches into the cell
+                    size_t s = (size_t)(std::upper_bound(kx.begin(), kx.end(), a) - kx.begin());
+                    s = (s > 0) ? std::min(s - 1, last) : 0;
+                    for (; s <= last; s++) {
+                        const T* p = &c[s * 4];
+                        T x0 = std::max(a, kx[s]), x1 = std::min(b, kx[s + 1]);
+                        if (s == last) {
+                            x1 = b;
+                        }
+                        if (s == 0) {
+                            x0 = a;
+                        }
+                        //difference table - spline at x (spline segment s)
+                        auto diff = [&](T x) {
+                            T u = x - kx[s];
+                            return std::fabs(v + slope * (x - a) - (p[0] + u * (p[1] + u * (p[2] + u * p[3]))));
+                        };
+                        if (x0 <= x1) {
+                            e = std::max(e, std::max(diff(x0), diff(x1)));
+                            //roots of the derivative of the difference: 3 d u^2 + 2 c u + (b - slope) = 0
+                            T qa = T(3) * p[3], qb = T(2) * p[2], qc = p[1] - slope;
+                            T roots[2];
+                            size_t n = 0;
+                            if (qa != T(0)) {
+                                T disc = qb * qb - T(4) * qa * qc;
+                                if (disc >= T(0)) {
+                                    T sq = std::sqrt(disc);
+                                    roots[n++] = (-qb + sq) / (T(2) * qa);
+                                    roots[n++] = (-qb - sq) / (T(2) * qa);
+                                }
+                            } else if (qb != T(0)) {
+                                roots[n++] = -qc / qb;
+                            }
+                            for (size_t k = 0; k < n; k++) {
+                                T x = kx[s] + roots[k];
+                                if (x > x0 && x < x1) {
+                                    e = std::max(e, diff(x));
+                                }
+                            }
+                            T h = x1 - kx[s];
+                            magnitude = std::max(magnitude, std::fabs(p[0]) + std::fabs(h * p[1]) + std::fabs(h * h * p[2]) + std::fabs(h * h * h * p[3]));
+                        }
+                        if (kx[s + 1] >= b) {
+                            break;
+                        }
+                    }
+                }
+                //rounding of both forwards (t is off by ~grid eps, the sums over the inputs add in_size roundings)
+                spline_error[i * out_size + j] = e + T(8 + in_size) * eps * magnitude;
+            }
+        }
+    });
+
+    //the errors of the splines of one output add up in the layer sum
+    for (size_t j = 0; j < out_size; j++) {
+        T e = T(0);
+        for (size_t i = 0; i < in_size; i++) {
+            e += spline_error[i * out_size + j];
+        }
+        error = std::max(error, e);
+    }
+    if (quantize) {
+        table = aligned_vector<T>(); //only the int16 table is used
+    }
+}
+
+template<typename T>
+T lut_layer_t<T>::entry(size_t i, size_t g, size_t j, T t) const {
+    size_t k = (i * grid + g) * 2 * out_size;
+    if (quantized) {
+        const T* s = &scales[i * 2 * out_size];
+        return s[j] * (T)table_q[k + j] + t * s[out_size + j] * (T)table_q[k + out_size + j];
+    }
+    return table[k + j] + t * table[k + out_size + j];
+}
+
+template<typename T>
+size_t lut_layer_t<T>::locate(size_t i, T x, T &t) const {
+    T r = (x - x_lo[i]) * inv_step[i];
+    if (boundary == boundary_policy::error) {
+        //unlike spline::forward x below the range is rejected too, the table has no cubic to continue there
+        if (!(x >= x_lo[i] && x <= x_hi[i])) {
+            print_err("x not in range of spline bounds. bounds : [", x_lo[i], ",", x_hi[i], "]");
+            throw std::runtime_error("x out of bounds");
+        }
+    } else if (boundary == boundary_policy::clamp) {
+        r = std::min((T)(grid - 1), std::max(T(0), r)); //nan goes to 0
+    }
+    //extrapolate keeps t outside of [0, 1], so the first/last cell continues linearly
+    T cell = std::min((T)(grid - 2), std::max(T(0), r));
+    size_t g = (size_t)cell;
+    t = r - (T)g;
+    return g;
+}
+
+template<typename T>
+void lut_layer_t<T>::add_row(size_t i, T x, T* out) const {
+    T t;
+    size_t g = locate(i, x, t);
+    size_t k = (i * grid + g) * 2 * out_size;
+    if (quantized) {
+        const int16_t* v = &table_q[k];
+        const int16_t* d = v + out_size;
+        const T* v_scale = &scales[i * 2 * out_size];
+        const T* d_scale = v_scale + out_size;
+        for (size_t j = 0; j < out_size; j++) {
+            out[j] += v_scale[j] * (T)v[j] + t * d_scale[j] * (T)d[j];
+        }
+        return;
+    }
+    const T* v = &table[k];
+    const T* d = v + out_size;
+    //one load of value and delta and one multiply add per spline, vectorizes over the outputs
+    for (size_t j = 0; j < out_size; j++) {
+        out[j] += v[j] + t * d[j];
+    }
+}
+
+template<typename T>
+void lut_layer_t<T>::forward_into(std::span<const T> x, std::span<T> out, bool normalize) const {
+    if (x.size() != in_size || out.size() != out_size) {
+        throw std::invalid_argument("forward_into: x must have the layers input size and out its output size");
+    }
+    std::fill(out.begin(), out.end(), T(0));
+    for (size_t i = 0; i < in_size; i++) {
+        add_row(i, x[i], out.data());
+    }
+    if (normalize) {
+        layer_t<T>::normalize_output(out);
+    }
+}
+
+template<typename T>
+std::vector<T> lut_layer_t<T>::forward(const std::vector<T> &x, bool normalize) const {
+    std::vector<T> output(out_size);
+    forward_into(x, output, normalize);
+    return output;
+}
+
+template<typename T>
+std::vector<std::vector<T>> lut_layer_t<T>::forward(const std::vector<std::vector<T>> &x, bool normalize) const {
+    std::vector<std::vector<T>> output(x.size(), std::vector<T>(out_size));
+    default_pool().parallel_for(x.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++) {
+            forward_into(x[b], output[b], normalize);
+        }
+    });
+    return output;
+}
+
+template class lut_layer_t<float>;
+template class lut_layer_t<double>;
+
+}//namespace
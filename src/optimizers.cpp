@@ -0,0 +1,63 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#include "../include/SplineNetLib/optimizers.hpp"
+
+#include <cmath>
+
+namespace SplineNetLib {
+
+template<typename T>
+void optimizer_update(const optimizer_t<T> &opt, T lr, T grad_scale, size_t t, T* y, T* grad, T* m, T* v, size_t n) {
+    //one branch per call, every loop is a plain elementwise pass the compiler vectorizes
+    switch (opt.kind) {
+    case optimizer_kind::sgd:
+        for (size_t i = 0; i < n; i++) {
+            y[i] -= lr * grad_scale * grad[i];
+            grad[i] = T(0);
+        }
+        break;
+    case optimizer_kind::momentum:
+        for (size_t i = 0; i < n; i++) {
+            m[i] = opt.beta1 * m[i] + grad_scale * grad[i];
+            y[i] -= lr * m[i];
+            grad[i] = T(0);
+        }
+        break;
+    case optimizer_kind::rmsprop:
+        for (size_t i = 0; i < n; i++) {
+            T g = grad_scale * grad[i];
+            v[i] = opt.beta2 * v[i] + (T(1) - opt.beta2) * g * g;
+            y[i] -= lr * g / (std::sqrt(v[i]) + opt.eps);
+            grad[i] = T(0);
+        }
+        break;
+    case optimizer_kind::adam: {
+        //bias corrections are folded into the step size and eps
+        T correction1 = T(1) - std::pow(opt.beta1, (T)t);
+        T correction2 = std::sqrt(T(1) - std::pow(opt.beta2, (T)t));
+        T step = lr * correction2 / correction1;
+        T eps = opt.eps * correction2;
+        for (size_t i = 0; i < n; i++) {
+            T g = grad_scale * grad[i];
+            m[i] = opt.beta1 * m[i] + (T(1) - opt.beta1) * g;
+            v[i] = opt.beta2 * v[i] + (T(1) - opt.beta2) * g * g;
+            y[i] -= step * m[i] / (std::sqrt(v[i]) + eps);
+            grad[i] = T(0);
+        }
+        break;
+    }
+    }
+}
+
+template void optimizer_update<float>(const optimizer_t<float>&, float, float, size_t, float*, float*, float*, float*, size_t);
+template void optimizer_update<double>(const optimizer_t<double>&, double, double, size_t, double*, double*, double*, double*, size_t);
+
+}//namespace
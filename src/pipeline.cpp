@@ -0,0 +1,218 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#include "../include/SplineNetLib/pipeline.hpp"
+
+namespace SplineNetLib {
+
+template<typename T>
+nn_pipeline_t<T>::nn_pipeline_t(const nn_t<T> &source, bool normalize, size_t num_stages, size_t micro_batch_size, size_t queue_capacity)
+    : micro_size(micro_batch_size) {
+    if (source.layers.empty()) {
+        throw std::invalid_argument("nn_pipeline: network has no layers");
+    }
+    if (micro_batch_size == 0) {
+        throw std::invalid_argument("nn_pipeline: micro_batch_size must be at least 1");
+    }
+    size_t num_layers = source.layers.size();
+    size_t num = (num_stages == 0) ? num_layers : std::min(num_stages, num_layers);
+
+    //cost of a layer is its number of splines, every stage gets consecutive layers until it reaches its share of the total
+    std::vector<double> cost(num_layers);
+    double total = 0.0;
+    for (size_t l = 0; l < num_layers; l++) {
+        cost[l] = (double)source.layers[l].input_size() * source.layers[l].output_size();
+        total += cost[l];
+    }
+    size_t l = 0;
+    double acc = 0.0;
+    for (size_t k = 0; k < num; k++) {
+        size_t begin = l;
+        double target = total * (double)(k + 1) / (double)num;
+        //at least one layer per stage and one left for every following stage
+        do {
+            acc += cost[l];
+            l++;
+        } while (l < num_layers - (num - k - 1) && acc + cost[l] / 2.0 <= target);
+
+        nn_t<T> part(0, {}, {}, {}, {});
+        part.layers.assign(source.layers.begin() + begin, source.layers.begin() + l);
+        stages.push_back(std::make_unique<stage_t>(stage_t{part.compile(normalize), normalize && k + 1 < num}));
+    }
+
+    for (size_t s = 0; s <= stages.size(); s++) {
+        queues.push_back(std::make_unique<spsc_queue<micro_batch>>(queue_capacity));
+    }
+    pending.values.reserve(micro_size * input_size());
+    for (size_t s = 0; s < stages.size(); s++) {
+        workers.emplace_back([this, s]() { run_stage(s); });
+    }
+}
+
+template<typename T>
+nn_pipeline_t<T>::~nn_pipeline_t() {
+    for (auto &queue : queues) {
+        queue->close();
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+template<typename T>
+void nn_pipeline_t<T>::run_stage(size_t s) {
+    const stage_t &stage = *stages[s];
+    const size_t in_width = stage.net.input_size(), out_width = stage.net.output_size();
+    std::vector<T> workspace(stage.net.workspace_size());
+    micro_batch in;
+    while (queues[s]->pop(in)) {
+        micro_batch out;
+        out.count = in.count;
+        out.error = in.error;
+        if (!out.error) {
+            try {
+                out.values.resize(in.count * out_width);
+                for (size_t b = 0; b < in.count; b++) {
+                    std::span<T> y(&out.values[b * out_width], out_width);
+                    stage.net.forward_into(std::span<const T>(&in.values[b * in_width], in_width), y, workspace);
+                    if (stage.normalize_output) {
+                        layer_t<T>::normalize_output(y);
+                    }
+                }
+            } catch (...) {
+                out.error = std::current_exception();
+            }
+        }
+        if (!queues[s + 1]->push(out)) {
+            return; //closed by the destructor
+        }
+    }
+}
+
+template<typename T>
+void nn_pipeline_t<T>::send_pending() {
+    in_flight.fetch_add(pending.count);
+    if (!queues[0]->push(pending)) {
+        throw std::runtime_error("nn_pipeline: pipeline was stopped");
+    }
+    pending = micro_batch();
+    pending.values.reserve(micro_size * input_size());
+}
+
+template<typename T>
+void nn_pipeline_t<T>::push(std::span<const T> x) {
+    if (x.size() != input_size()) {
+        throw std::invalid_argument("push: x must have the networks input size");
+    }
+    pending.values.insert(pending.values.end(), x.begin(), x.end());
+    pending.count++;
+    if (pending.count == micro_size) {
+        send_pending();
+    }
+}
+
+template<typename T>
+void nn_pipeline_t<T>::flush() {
+    if (pending.count > 0) {
+        send_pending();
+    }
+}
+
+template<typename T>
+std::vector<T> nn_pipeline_t<T>::take_result() {
+    if (current.error) {
+        //the whole micro batch of the failing sample is dropped
+        in_flight.fetch_sub(current.count - current_index);
+        current_index = current.count;
+        std::rethrow_exception(current.error);
+    }
+    size_t width = output_size();
+    std::vector<T> y(current.values.begin() + current_index * width, current.values.begin() + (current_index + 1) * width);
+    current_index++;
+    in_flight.fetch_sub(1);
+    return y;
+}
+
+template<typename T>
+std::vector<T> nn_pipeline_t<T>::pop() {
+    if (current_index == current.count) {
+        if (!queues.back()->pop(current)) {
+            throw std::runtime_error("nn_pipeline: pipeline was stopped");
+        }
+        current_index = 0;
+    }
+    return take_result();
+}
+
+template<typename T>
+bool nn_pipeline_t<T>::try_pop(std::vector<T> &y) {
+    if (current_index == current.count) {
+        if (!queues.back()->try_pop(current)) {
+            return false;
+        }
+        current_index = 0;
+    }
+    y = take_result();
+    return true;
+}
+
+template<typename T>
+std::vector<std::vector<T>> nn_pipeline_t<T>::forward(const std::vector<std::vector<T>> &x) {
+    if (in_flight.load() != 0 || pending.count != 0) {
+        throw std::logic_error("forward: results of push are still pending");
+    }
+    const size_t in_width = input_size(), out_width = output_size();
+    for (const std::vector<T> &sample : x) {
+        if (sample.size() != in_width) {
+            throw std::invalid_argument("forward: every sample must have the networks input size");
+        }
+    }
+    std::vector<std::vector<T>> output(x.size());
+    std::exception_ptr error;
+    size_t next = 0, done = 0;
+    micro_batch batch;
+    while (done < x.size()) {
+        if (next < x.size()) {
+            if (batch.count == 0) {
+                batch.count = std::min(micro_size, x.size() - next);
+                batch.values.reserve(batch.count * in_width);
+                for (size_t b = next; b < next + batch.count; b++) {
+                    batch.values.insert(batch.values.end(), x[b].begin(), x[b].end());
+                }
+            }
+            size_t count = batch.count;
+            if (queues[0]->try_push(batch)) {
+                next += count;
+                batch = micro_batch();
+                continue;
+            }
+        }
+        //stage 0 is full or everything is sent, so at least one batch is on its way to the results
+        micro_batch result;
+        queues.back()->pop(result);
+        if (result.error) {
+            error = error ? error : result.error;
+        } else {
+            for (size_t b = 0; b < result.count; b++) {
+                output[done + b].assign(result.values.begin() + b * out_width, result.values.begin() + (b + 1) * out_width);
+            }
+        }
+        done += result.count;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return output;
+}
+
+template class nn_pipeline_t<float>;
+template class nn_pipeline_t<double>;
+
+}//namespace
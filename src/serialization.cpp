@@ -0,0 +1,373 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#include "../include/SplineNetLib/serialization.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SPLINENETLIB_MMAP
+#endif
+
+namespace SplineNetLib {
+
+static_assert(sizeof(model_file_header) == 32, "model_file_header must not have padding");
+static_assert(sizeof(model_layer_header) == 48, "model_layer_header must not have padding");
+
+mapped_file::mapped_file(const std::string &path) {
+#ifdef SPLINENETLIB_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("load: cant open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("load: cant read the size of " + path);
+    }
+    length = (size_t)info.st_size;
+    if (length > 0) {
+        void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("load: cant map " + path);
+        }
+        bytes = static_cast<const unsigned char*>(address);
+        mapped = true;
+    }
+    ::close(fd); //the mapping stays valid without the descriptor
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("load: cant open " + path);
+    }
+    length = (size_t)in.tellg();
+    buffer.resize(length);
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize)length);
+    bytes = buffer.data();
+#endif
+}
+
+mapped_file::~mapped_file() {
+#ifdef SPLINENETLIB_MMAP
+    if (mapped) {
+        ::munmap(const_cast<unsigned char*>(bytes), length);
+    }
+#endif
+}
+
+namespace {
+
+constexpr uint32_t byte_order_mark = 0x01020304;
+
+size_t align_64(size_t offset) {
+    return (offset + 63) / 64 * 64;
+}
+
+//checks the file header and returns the (checked) layer headers
+template<typename T>
+std::vector<model_layer_header> read_headers(const mapped_file &file) {
+    model_file_header header;
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error("load: file is too small to be a model.");
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, "SPNL", 4) != 0) {
+        throw std::runtime_error("load: not a SplineNetLib model file.");
+    }
+    if (header.byte_order != byte_order_mark) {
+        throw std::runtime_error("load: model was saved with a different byte order.");
+    }
+    if (header.version != model_format_version) {
+        throw std::runtime_error("load: unsupported model format version " + std::to_string(header.version) + ".");
+    }
+    if (header.scalar_size != sizeof(T)) {
+        throw std::runtime_error("load: model was saved with a different scalar type (float/double).");
+    }
+    if (header.num_layers == 0 || sizeof(header) + (uint64_t)header.num_layers * sizeof(model_layer_header) > file.size()) {
+        throw std::runtime_error("load: invalid number of layers.");
+    }
+
+    std::vector<model_layer_header> layers(header.num_layers);
+    std::memcpy(layers.data(), file.data() + sizeof(header), layers.size() * sizeof(model_layer_header));
+    for (const model_layer_header &l : layers) {
+        uint64_t splines = (uint64_t)l.in_size * l.out_size;
+        uint64_t points = (uint64_t)l.detail + 2;
+        bool valid = splines > 0 && l.kind <= (uint32_t)spline_kind::bspline && l.boundary <= (uint32_t)boundary_policy::extrapolate;
+        //the element counts below must not wrap around (a crafted header could make them 0 and pass the size check)
+        valid = valid && splines <= UINT64_MAX / points / 4;
+        //every array must be aligned for T and inside the file
+        auto inside = [&](uint64_t offset, uint64_t count) {
+            return offset % alignof(T) == 0 && offset <= file.size() && count <= (file.size() - offset) / sizeof(T);
+        };
+        valid = valid && inside(l.knot_x, splines * points) && inside(l.knot_y, splines * points) && inside(l.coeffs, splines * (points - 1) * 4);
+        if (!valid) {
+            throw std::runtime_error("load: invalid layer header.");
+        }
+    }
+    //every layer reads the output of the one before it
+    for (size_t l = 1; l < layers.size(); l++) {
+        if (layers[l].in_size != layers[l - 1].out_size) {
+            throw std::runtime_error("load: layer sizes dont match.");
+        }
+    }
+    return layers;
+}
+
+template<typename T>
+void write_model(const std::vector<const layer_t<T>*> &layers, const std::string &path) {
+    //offsets of all arrays first, they go into the layer headers
+    std::vector<model_layer_header> headers(layers.size());
+    size_t offset = align_64(sizeof(model_file_header) + layers.size() * sizeof(model_layer_header));
+    for (size_t l = 0; l < layers.size(); l++) {
+        const layer_t<T> &layer = *layers[l];
+        model_layer_header &h = headers[l];
+        std::memset(&h, 0, sizeof(h));
+        h.in_size = layer.input_size();
+        h.out_size = layer.output_size();
+        h.detail = layer.get_detail();
+        h.kind = (uint32_t)layer.get_kind();
+        h.boundary = (uint32_t)layer.get_boundary();
+        size_t splines = (size_t)h.in_size * h.out_size;
+        size_t points = (size_t)h.detail + 2;
+        for (size_t i = 0; i < h.in_size; i++) {
+            for (size_t j = 0; j < h.out_size; j++) {
+                if (layer.get_spline(i, j).get_knot_x().size() != points) {
+                    throw std::runtime_error("save: all splines of a layer must have detail + 2 points.");
+                }
+            }
+        }
+        h.knot_x = offset;
+        offset = align_64(offset + splines * points * sizeof(T));
+        h.knot_y = offset;
+        offset = align_64(offset + splines * points * sizeof(T));
+        h.coeffs = offset;
+        offset = align_64(offset + splines * (points - 1) * 4 * sizeof(T));
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("save: cant open " + path);
+    }
+    size_t position = 0;
+    auto write = [&](const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), (std::streamsize)size);
+        position += size;
+    };
+    auto pad_to = [&](size_t target) {
+        static const char zeros[64] = {};
+        write(zeros, target - position);
+    };
+
+    model_file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "SPNL", 4);
+    header.version = model_format_version;
+    header.scalar_size = sizeof(T);
+    header.num_layers = (uint32_t)layers.size();
+    header.byte_order = byte_order_mark;
+    write(&header, sizeof(header));
+    write(headers.data(), headers.size() * sizeof(model_layer_header));
+
+    for (size_t l = 0; l < layers.size(); l++) {
+        const layer_t<T> &layer = *layers[l];
+        const model_layer_header &h = headers[l];
+        //the same spline order ([in][out]) for all three arrays
+        pad_to(h.knot_x);
+        for (size_t i = 0; i < h.in_size; i++) {
+            for (size_t j = 0; j < h.out_size; j++) {
+                std::span<const T> values = layer.get_spline(i, j).get_knot_x();
+                write(values.data(), values.size_bytes());
+            }
+        }
+        pad_to(h.knot_y);
+        for (size_t i = 0; i < h.in_size; i++) {
+            for (size_t j = 0; j < h.out_size; j++) {
+                std::span<const T> values = layer.get_spline(i, j).get_knot_y();
+                write(values.data(), values.size_bytes());
+            }
+        }
+        pad_to(h.coeffs);
+        for (size_t i = 0; i < h.in_size; i++) {
+            for (size_t j = 0; j < h.out_size; j++) {
+                std::span<const T> values = layer.get_spline(i, j).get_coeffs();
+                write(values.data(), values.size_bytes());
+            }
+        }
+    }
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("save: cant write " + path);
+    }
+}
+
+template<typename T>
+layer_t<T> read_layer(const mapped_file &file, const model_layer_header &h) {
+    size_t splines = (size_t)h.in_size * h.out_size;
+    size_t points = (size_t)h.detail + 2;
+    const T* knot_x = reinterpret_cast<const T*>(file.data() + h.knot_x);
+    const T* knot_y = reinterpret_cast<const T*>(file.data() + h.knot_y);
+    const T* coeffs = reinterpret_cast<const T*>(file.data() + h.coeffs);
+    return layer_t<T>(h.in_size, h.out_size, h.detail,
+                      std::span<const T>(knot_x, splines * points), std::span<const T>(knot_y, splines * points),
+                      std::span<const T>(coeffs, splines * (points - 1) * 4), (spline_kind)h.kind, (boundary_policy)h.boundary);
+}
+
+//spline::forward on the flat arrays of one spline (kx has points values, c has points - 1 segments)
+template<typename T>
+T evaluate_flat(const T* kx, const T* c, size_t points, boundary_policy boundary, T x) {
+    T xb = x;
+    if (boundary == boundary_policy::error) {
+        if (!(x <= kx[points - 1])) {
+            print_err("x not in range of spline bounds. bounds : [", kx[0], ",", kx[points - 1], "]");
+            throw std::runtime_error("x out of bounds");
+        }
+    } else {
+        xb = std::min(kx[points - 1], std::max(kx[0], x));
+    }
+    //branch light binary search like spline::find_segment
+    const T* base = kx + 1;
+    size_t len = points - 1;
+    while (len > 1) {
+        size_t half = len / 2;
+        base = (base[half - 1] < xb) ? base + half : base;
+        len -= half;
+    }
+    size_t i = (size_t)(base - kx) + (*base < xb);
+    size_t last = points - 2;
+    i = (i - 1 < last) ? i - 1 : last;
+
+    const T* p = c + i * 4;
+    T u = xb - kx[i];
+    T y = p[0] + u * (p[1] + u * (p[2] + u * p[3]));
+    if (boundary == boundary_policy::extrapolate) {
+        y += (p[1] + u * (T(2) * p[2] + T(3) * u * p[3])) * (x - xb);
+    }
+    return y;
+}
+
+}//namespace
+
+template<typename T>
+void save(const layer_t<T> &layer, const std::string &path) {
+    write_model<T>({&layer}, path);
+}
+
+template<typename T>
+void save(const nn_t<T> &network, const std::string &path) {
+    std::vector<const layer_t<T>*> layers;
+    for (const layer_t<T> &layer : network.layers) {
+        layers.push_back(&layer);
+    }
+    if (layers.empty()) {
+        throw std::runtime_error("save: network has no layers.");
+    }
+    write_model<T>(layers, path);
+}
+
+template<typename T>
+layer_t<T> load_layer(const std::string &path) {
+    mapped_file file(path);
+    std::vector<model_layer_header> headers = read_headers<T>(file);
+    if (headers.size() != 1) {
+        throw std::runtime_error("load_layer: file has more than one layer (use load_nn).");
+    }
+    return read_layer<T>(file, headers[0]);
+}
+
+template<typename T>
+nn_t<T> load_nn(const std::string &path) {
+    mapped_file file(path);
+    std::vector<model_layer_header> headers = read_headers<T>(file);
+    nn_t<T> network(0, {}, {}, {}, {});
+    network.layers.reserve(headers.size());
+    for (const model_layer_header &h : headers) {
+        network.layers.push_back(read_layer<T>(file, h));
+    }
+    return network;
+}
+
+template<typename T>
+mapped_model_t<T>::mapped_model_t(const std::string &path) : file(path) {
+    std::vector<model_layer_header> headers = read_headers<T>(file);
+    for (const model_layer_header &h : headers) {
+        views.push_back({h.in_size, h.out_size, h.detail + 2, (boundary_policy)h.boundary,
+                         reinterpret_cast<const T*>(file.data() + h.knot_x), reinterpret_cast<const T*>(file.data() + h.coeffs)});
+        max_width = std::max<size_t>(max_width, std::max(h.in_size, h.out_size));
+    }
+}
+
+template<typename T>
+void mapped_model_t<T>::layer_forward(const layer_view &l, const T* x, T* out) const {
+    size_t segments = l.points - 1;
+    std::fill(out, out + l.out_size, T(0));
+    for (size_t i = 0; i < l.in_size; i++) {
+        for (size_t j = 0; j < l.out_size; j++) {
+            size_t k = i * l.out_size + j;
+            out[j] += evaluate_flat(l.knot_x + k * l.points, l.coeffs + k * segments * 4, l.points, l.boundary, x[i]);
+        }
+    }
+}
+
+template<typename T>
+void mapped_model_t<T>::forward_into(std::span<const T> x, std::span<T> out, bool normalize, std::span<T> workspace) const {
+    if (x.size() != input_size() || out.size() != output_size() || workspace.size() < workspace_size()) {
+        throw std::invalid_argument("forward_into: x, out or workspace have the wrong size");
+    }
+    //the layers write alternately into the two halves of workspace, the last one into out
+    const T* current = x.data();
+    for (size_t l = 0; l < views.size(); l++) {
+        bool last = (l + 1 == views.size());
+        T* next = last ? out.data() : workspace.data() + (l % 2) * max_width;
+        layer_forward(views[l], current, next);
+        if (normalize && !last) {
+            layer_t<T>::normalize_output(std::span<T>(next, views[l].out_size));
+        }
+        current = next;
+    }
+}
+
+template<typename T>
+std::vector<T> mapped_model_t<T>::forward(const std::vector<T> &x, bool normalize) const {
+    std::vector<T> output(output_size()), workspace(workspace_size());
+    forward_into(x, output, normalize, workspace);
+    return output;
+}
+
+template<typename T>
+std::vector<std::vector<T>> mapped_model_t<T>::forward(const std::vector<std::vector<T>> &x, bool normalize) const {
+    std::vector<std::vector<T>> output(x.size(), std::vector<T>(output_size()));
+    default_pool().parallel_for(x.size(), grain, [&](size_t begin, size_t end) {
+        std::vector<T> workspace(workspace_size()); //one per chunk
+        for (size_t b = begin; b < end; b++) {
+            forward_into(x[b], output[b], normalize, workspace);
+        }
+    });
+    return output;
+}
+
+template void save<float>(const layer_t<float>&, const std::string&);
+template void save<double>(const layer_t<double>&, const std::string&);
+template void save<float>(const nn_t<float>&, const std::string&);
+template void save<double>(const nn_t<double>&, const std::string&);
+template layer_t<float> load_layer<float>(const std::string&);
+template layer_t<double> load_layer<double>(const std::string&);
+template nn_t<float> load_nn<float>(const std::string&);
+template nn_t<double> load_nn<double>(const std::string&);
+template class mapped_model_t<float>;
+template class mapped_model_t<double>;
+
+}//namespace
@@ -9,12 +9,32 @@
 
 #include "../include/SplineNetLib/splines.hpp"
 
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace SplineNetLib {
     
 bool parallel = false;
 
+#if defined(__AVX512F__)
+namespace {
+    //gathers in the masked form with a zero source (same instruction), the unmasked _mm512_i64gather_pd/_mm512_i32gather_ps
+    //start from an undefined register
+    inline __m512d gather_pd(__m512i idx, const double* base) {
+        return _mm512_mask_i64gather_pd(_mm512_setzero_pd(), (__mmask8)0xFF, idx, base, 8);
+    }
+    inline __m512 gather_ps(__m512i idx, const float* base) {
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), (__mmask16)0xFFFF, idx, base, 4);
+    }
+}
+#endif
+
 
-spline::spline(const std::vector < std::vector < double>> points_list, const std::vector < std::vector < double>> params_list){
+template<typename T>
+spline_t<T>::spline_t(const std::vector < std::vector < T>> points_list, const std::vector < std::vector < T>> params_list, spline_kind _kind) : kind(_kind) {
     if (points_list.size() < 2) {
         throw std::runtime_error("to few points in points_list. (Minimum num points == 2)");
     }
@@ -27,167 +47,619 @@ spline::spline(const std::vector < std::vector < double>> points_list, const std
             throw std::runtime_error("invalid points_list dimensions");
         }
     }
-    for (size_t i = 0; i < params_list.size()-1; i++) {
+    for (size_t i = 0; i < params_list.size(); i++) {
         if (params_list[i].size() != 4) {
             print_err("inconsistent size of parameters at params_list[", i, "] (mustbbe ==4)");
             throw std::runtime_error("invalid params_list size");
         }
     }
-    params = params_list;
-    points = points_list;
     
-    grad = std::vector<double> (params_list.size(),0.0);//vec of length of num of sub segments in spline
-    //std::cout<<"params_list size "<<params.size()<<"\n";
+    //copy the nested lists into the flat storage
+    knot_x.resize(points_list.size());
+    knot_y.resize(points_list.size());
+    for (size_t i = 0; i < points_list.size(); i++) {
+        knot_x[i] = points_list[i][0];
+        knot_y[i] = points_list[i][1];
+    }
+    coeffs.resize(params_list.size() * 4);
+    for (size_t i = 0; i < params_list.size(); i++) {
+        for (size_t k = 0; k < 4; k++) {
+            coeffs[i * 4 + k] = params_list[i][k];
+        }
+    }
+    
+    grad = aligned_vector<T> (points_list.size(),T(0));//vec of length of num of points (grad[i] adjusts y of points[i], i = upper point of the segment)
+    
+    init_locator();
 }
 
-void spline::interpolation() {
-    //std::cout<<"interpolation call\n";
+template<typename T>
+spline_t<T>::spline_t(std::span<const T> x, std::span<const T> y, std::span<const T> _coeffs, spline_kind _kind) : kind(_kind) {
+    if (x.size() < 2) {
+        throw std::runtime_error("to few points in points_list. (Minimum num points == 2)");
+    }
+    if (y.size() != x.size() || _coeffs.size() != (x.size() - 1) * 4) {
+        throw std::runtime_error("invalid num of parameters. (y.size()==x.size(), coeffs.size()==(x.size()-1)*4)");
+    }
+    knot_x.assign(x.begin(), x.end());
+    knot_y.assign(y.begin(), y.end());
+    coeffs.assign(_coeffs.begin(), _coeffs.end());
+    grad = aligned_vector<T>(x.size(), T(0));
+    init_locator();
+}
 
+template<typename T>
+void spline_t<T>::init_locator() {
+    size_t num_segments = knot_x.size() - 1;
+    T h = knot_x[1] - knot_x[0];
+    
+    //all segments exept the last must have the same width, the last one may be wider
+    //(layer::layer puts the last point at max so the last segment is 2 times as wide)
+    uniform = h > T(0);
+    T tolerance = std::sqrt(std::numeric_limits<T>::epsilon()) * h;
+    for (size_t i = 1; i < num_segments && uniform; i++) {
+        T h_i = knot_x[i + 1] - knot_x[i];
+        if (i < num_segments - 1) {
+            uniform = std::fabs(h_i - h) <= tolerance;
+        } else {
+            uniform = h_i >= h - tolerance;
+        }
+    }
+    
+    x_min = knot_x[0];
+    inv_h = uniform ? T(1) / h : T(0);
+}
 
-    //append temporay param list to store edge values in forward and backward
-    params.push_back(std::vector < double > (4));
+template<typename T>
+size_t spline_t<T>::find_segment(T x) const {
+    size_t last = knot_x.size() - 2; //index of the last segment
+    
+    if (uniform) {
+        //segment i covers (x_i, x_i+1] so the index is ceil(r)-1, r is clamped first so the cast is always valid
+        T r = std::min(std::max((x - x_min) * inv_h, T(0)), (T)last + T(1));
+        size_t i = (size_t)std::ceil(r);
+        i = (i > 0) ? i - 1 : 0;
+        return (i < last) ? i : last;
+    }
+    
+    //branch light binary search for the first knot >= x (starting at knot 1)
+    const T* base = knot_x.data() + 1;
+    size_t len = knot_x.size() - 1;
+    while (len > 1) {
+        size_t half = len / 2;
+        base = (base[half - 1] < x) ? base + half : base;
+        len -= half;
+    }
+    size_t i = (size_t)(base - knot_x.data()) + (*base < x);
+    //i is the index of the upper knot of the segment
+    return (i - 1 < last) ? i - 1 : last;
+}
 
-    int n = points.size() - 1; // Number of intervals
+template<typename T>
+spline_factorization_t<T>::spline_factorization_t(const aligned_vector<T> &x) : knot_x(x) {
+    int n = x.size() - 1; // Number of intervals
     if (n < 1) {
         throw std::runtime_error("Not enough points for interpolation.");
     }
-
-    std::vector < double > h(n),
-    alpha(n),
-    l(n + 1),
-    mu(n + 1),
-    z(n + 1);
+    
+    h.resize(n);
+    inv_h.resize(n);
+    inv_l.resize(n + 1);
+    mu.resize(n + 1);
+    
     // Compute h
     for (int i = 0; i < n; ++i) {
-        h[i] = points[i + 1][0] - points[i][0];
+        h[i] = x[i + 1] - x[i];
+        inv_h[i] = T(1) / h[i];
     }
-
-    // Compute alpha
+    
+    // Forward sweep (only the x dependent part, z is done in spline::interpolation)
+    inv_l[0] = T(1);
+    mu[0] = T(0);
     for (int i = 1; i < n; ++i) {
-        alpha[i] = (3.0 / h[i]) * (points[i + 1][1] - points[i][1]) -
-        (3.0 / h[i - 1]) * (points[i][1] - points[i - 1][1]);
+        T l = T(2) * (x[i + 1] - x[i - 1]) - h[i - 1] * mu[i - 1];
+        inv_l[i] = T(1) / l;
+        mu[i] = h[i] * inv_l[i];
+    }
+    inv_l[n] = T(1);
+    mu[n] = T(0);
+}
+
+template<typename T>
+std::shared_ptr<const spline_factorization_t<T>> spline_t<T>::get_factorization() {
+    if (!factorization) {
+        factorization = std::make_shared<const spline_factorization_t<T>>(knot_x);
     }
+    return factorization;
+}
 
-    // Initialize l, mu, and z
-    l[0] = 1.0;
-    mu[0] = z[0] = 0.0;
+template<typename T>
+void spline_t<T>::share_factorization(std::shared_ptr<const spline_factorization_t<T>> shared) {
+    if (!shared || !shared->matches(knot_x)) {
+        throw std::invalid_argument("share_factorization: factorization was built for different knots.");
+    }
+    factorization = std::move(shared);
+}
 
-    // Forward sweep
+template<typename T>
+void spline_t<T>::interpolation() {
+    //std::cout<<"interpolation call\n";
+
+    int n = knot_x.size() - 1; // Number of intervals
+    if (n < 1) {
+        throw std::runtime_error("Not enough points for interpolation.");
+    }
+    
+    if (kind == spline_kind::bspline) {
+        //local support, every segment only depends on its own 4 control points
+        update_bspline_segments(0, n - 1);
+        return;
+    }
+    
+    //h, l and mu only depend on the knot x values and are cached, only the y dependent substitution is done here
+    const spline_factorization_t<T>& f = *get_factorization();
+    const T* h = f.h.data();
+    const T* inv_h = f.inv_h.data();
+    const T* inv_l = f.inv_l.data();
+    const T* mu = f.mu.data();
+    const T* y = knot_y.data();
+    T* p = coeffs.data();
+
+    // Forward substitution, z[i] is stored in the c slot of segment i (z[0] = 0)
+    T z_prev = T(0);
     for (int i = 1; i < n; ++i) {
-        l[i] = 2.0 * (points[i + 1][0] - points[i - 1][0]) - h[i - 1] * mu[i - 1];
-        mu[i] = h[i] / l[i];
-        z[i] = (alpha[i] - h[i - 1] * z[i - 1]) / l[i];
+        T alpha = T(3) * (y[i + 1] - y[i]) * inv_h[i] - T(3) * (y[i] - y[i - 1]) * inv_h[i - 1];
+        z_prev = (alpha - h[i - 1] * z_prev) * inv_l[i];
+        p[i * 4 + 2] = z_prev;
     }
+    p[2] = T(0);
 
-    l[n] = 1.0;
-    z[n] = params[n][2] = 0.0; // Assuming natural spline conditions
+    T c_next = T(0); // Assuming natural spline conditions (c of the temporary edge segment n)
 
     // Back substitution
     for (int j = n-1; j >= 0; --j) {
-        params[j][2] = z[j] - mu[j] * params[j+1][2];
-        params[j][1] = (points[j+1][1] - points[j][1]) / h[j] - h[j] * (params[j+1][2] + 2.0 * params[j][2]) / 3.0;
-        params[j][3] = (params[j+1][2] - params[j][2]) / (3.0 * h[j]);
-        params[j][0] = points[j][1];
-    }
-
-    params.pop_back(); //remove temp placeholders
-/*debug
-    //to print interpolation result
-    for (size_t i = 0; i < params.size(); ++i) {
-        for (size_t j = 0; j < params[i].size(); ++j) {
-            std::cout << params[i][j] << " "; // Print each value in the parameter vector
-        }
-        std::cout << "\n"; // New line after each parameter set
+        T* p_j = p + j * 4;
+        p_j[2] = p_j[2] - mu[j] * c_next;
+        p_j[1] = (y[j+1] - y[j]) * inv_h[j] - h[j] * (c_next + T(2) * p_j[2]) / T(3);
+        p_j[3] = (c_next - p_j[2]) * inv_h[j] / T(3);
+        p_j[0] = y[j];
+        c_next = p_j[2];
     }
+}
 
-    for (size_t i = 0; i < points.size(); ++i) {
-        for (size_t j = 0; j < points[i].size(); ++j) {
-            std::cout << points[i][j] << " "; // Print each value in the parameter vector
-        }
-        std::cout << "\n"; // New line after each parameter set
+template<typename T>
+void spline_t<T>::update_bspline_segments(size_t first, size_t last) {
+    //the basis of segment i is written in the power form of u = x - x_i (t = u / h) so forward, the simd kernels
+    //and the packed layer kernel evaluate it like any other segment
+    const size_t last_point = knot_y.size() - 1;
+    const T* y = knot_y.data();
+    for (size_t i = first; i <= last; i++) {
+        T p0 = y[(i > 0) ? i - 1 : 0];
+        T p1 = y[i];
+        T p2 = y[i + 1];
+        T p3 = y[std::min(i + 2, last_point)];
+        T inv_h = T(1) / (knot_x[i + 1] - knot_x[i]);
+        T* p = &coeffs[i * 4];
+        p[0] = (p0 + T(4) * p1 + p2) / T(6);
+        p[1] = (p2 - p0) / T(2) * inv_h;
+        p[2] = (p0 - T(2) * p1 + p2) / T(2) * inv_h * inv_h;
+        p[3] = (-p0 + T(3) * p1 - T(3) * p2 + p3) / T(6) * inv_h * inv_h * inv_h;
     }
-*/
 }
 
-double spline::forward(double x) {
+template<typename T>
+T spline_t<T>::forward(T x) const {
     //std::cout<<"spline fwd call\n";
-    if (points.empty() || params.empty()) {
+    if (knot_x.empty() || coeffs.empty()) {
         throw std::runtime_error("No points or parameters defined for spline.");
     }
     
+    //throws for boundary_policy::error, clamps otherwise
+    T xb = bound_input(x);
+    
     // Find the interval that x belongs to
-    size_t i;
-    for (i = 1; i < points.size(); i++) {
-        if (x <= points[i][0]) {
-            // Use the previous spline segment's params
-            x = x - points[i - 1][0]; // Adjust x relative to the spline
-            // Perform cubic polynomial interpolation using the parameters
-            return params[i - 1][0] + params[i - 1][1] * x + params[i - 1][2] * (x * x) + params[i - 1][3] * (x * x * x);
-            //for output caching 
-            /*
-            double out = params[i - 1][0] + params[i - 1][1] * x + params[i - 1][2] * (x * x) + params[i - 1][3] * (x * x * x);
-            batch_outputs.push_back(out);
-            return out;
-            */
-            // Found the correct interval
+    size_t i = find_segment(xb);
+    // Perform cubic polynomial interpolation using the parameters (horner form)
+    return evaluate_segment(i, xb, x);
+}
+
+template<typename T>
+T spline_t<T>::forward_segment(T x, uint32_t &segment, T &offset) const {
+    if (knot_x.empty() || coeffs.empty()) {
+        throw std::runtime_error("No points or parameters defined for spline.");
+    }
+    
+    T xb = bound_input(x);
+    size_t i = find_segment(xb);
+    segment = (uint32_t)i;
+    offset = xb - knot_x[i];
+    return evaluate_segment(i, xb, x);
+}
+
+//gcc 12 implements the unmasked avx512 intrinsics (min, max, slli, roundscale, ...) on top of _mm512_undefined_*()
+//and then warns about that undefined source once they are inlined here, the kernels only use fully defined lanes
+#if defined(__AVX512F__) && defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+template<>
+size_t spline_t<double>::forward_batch_simd(const double* xs, double* ys, size_t n) const {
+    size_t b = 0;
+#if defined(__AVX512F__)
+    const double x_max = knot_x.back();
+    const double* kx = knot_x.data();
+    const double* c = coeffs.data();
+    //8 lanes, segment lookup like find_segment, coefficients are gathered from the interleaved a,b,c,d array
+    const size_t last = knot_x.size() - 2; //index of the last segment
+    const __m512d v_max = _mm512_set1_pd(x_max);
+    const __m512d v_min = _mm512_set1_pd(x_min);
+    const __m512d v_inv_h = _mm512_set1_pd(inv_h);
+    const __m512d v_zero = _mm512_setzero_pd();
+    const __m512d v_one = _mm512_set1_pd(1.0);
+    const __m512d v_three = _mm512_set1_pd(3.0);
+    const __m512d v_last = _mm512_set1_pd((double)last);
+    const __m512d v_end = _mm512_set1_pd((double)last + 1.0);
+    const __m512d v_magic = _mm512_set1_pd(4503599627370496.0); //2^52, adding it moves a small integer into the low mantissa bits
+    
+    for (; b + 8 <= n; b += 8) {
+        __m512d x_in = _mm512_loadu_pd(xs + b);
+        __m512d x = x_in;
+        if (boundary == boundary_policy::error) {
+            if (_mm512_cmp_pd_mask(x, v_max, _CMP_NLE_UQ)) {
+                break; //out of range (or nan), the scalar loop below reports it
+            }
+        } else {
+            x = _mm512_min_pd(_mm512_max_pd(x, v_min), v_max); //max returns v_min for nan lanes
+        }
+        
+        __m512i seg;
+        if (uniform) {
+            __m512d r = _mm512_min_pd(_mm512_max_pd(_mm512_mul_pd(_mm512_sub_pd(x, v_min), v_inv_h), v_zero), v_end);
+            r = _mm512_roundscale_pd(r, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+            r = _mm512_min_pd(_mm512_max_pd(_mm512_sub_pd(r, v_one), v_zero), v_last);
+            seg = _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(r, v_magic)), _mm512_castpd_si512(v_magic));
+        } else {
+            //vectorized branch light binary search, seg holds the base index of every lane
+            seg = _mm512_set1_epi64(1);
+            size_t len = knot_x.size() - 1;
+            while (len > 1) {
+                size_t half = len / 2;
+                __mmask8 lt = _mm512_cmp_pd_mask(gather_pd(seg, kx + half - 1), x, _CMP_LT_OQ);
+                seg = _mm512_mask_add_epi64(seg, lt, seg, _mm512_set1_epi64((long long)half));
+                len -= half;
+            }
+            __mmask8 lt = _mm512_cmp_pd_mask(gather_pd(seg, kx), x, _CMP_LT_OQ);
+            seg = _mm512_mask_add_epi64(seg, lt, seg, _mm512_set1_epi64(1));
+            //seg is the upper knot now, x <= x_max guarantees seg - 1 <= last
+            seg = _mm512_sub_epi64(seg, _mm512_set1_epi64(1));
         }
+        
+        __m512d u = _mm512_sub_pd(x, gather_pd(seg, kx));
+        __m512i idx = _mm512_slli_epi64(seg, 2);
+        __m512d va = gather_pd(idx, c);
+        __m512d vb = gather_pd(idx, c + 1);
+        __m512d vc = gather_pd(idx, c + 2);
+        __m512d vd = gather_pd(idx, c + 3);
+        
+        __m512d y = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_fmadd_pd(vd, u, vc), u, vb), u, va);
+        if (boundary == boundary_policy::extrapolate) {
+            //slope at the clamped x, x_in - x is 0 for the lanes inside the knots
+            __m512d slope = _mm512_fmadd_pd(_mm512_fmadd_pd(_mm512_mul_pd(v_three, vd), u, _mm512_add_pd(vc, vc)), u, vb);
+            y = _mm512_fmadd_pd(slope, _mm512_sub_pd(x_in, x), y);
+        }
+        _mm512_storeu_pd(ys + b, y);
     }
+#elif defined(__AVX2__)
+    const double x_max = knot_x.back();
+    const double* kx = knot_x.data();
+    const double* c = coeffs.data();
+    //4 lanes, segment lookup like find_segment, the 4 a,b,c,d rows are loaded (32 byte aligned) and transposed
+    const size_t last = knot_x.size() - 2; //index of the last segment
+    const __m256d v_max = _mm256_set1_pd(x_max);
+    const __m256d v_min = _mm256_set1_pd(x_min);
+    const __m256d v_inv_h = _mm256_set1_pd(inv_h);
+    const __m256d v_zero = _mm256_setzero_pd();
+    const __m256d v_one = _mm256_set1_pd(1.0);
+    const __m256d v_three = _mm256_set1_pd(3.0);
+    const __m256d v_last = _mm256_set1_pd((double)last);
+    const __m256d v_end = _mm256_set1_pd((double)last + 1.0);
+    const __m256d v_magic = _mm256_set1_pd(4503599627370496.0); //2^52, adding it moves a small integer into the low mantissa bits
     
-    // x does not exist in the control points
-    print_err("x not in range of spline bounds. bounds : [", points[0][0], ",", points[points.size() - 1][0], "]");
-    throw std::runtime_error("x out of bounds");
+    for (; b + 4 <= n; b += 4) {
+        __m256d x_in = _mm256_loadu_pd(xs + b);
+        __m256d x = x_in;
+        if (boundary == boundary_policy::error) {
+            if (_mm256_movemask_pd(_mm256_cmp_pd(x, v_max, _CMP_NLE_UQ))) {
+                break; //out of range (or nan), the scalar loop below reports it
+            }
+        } else {
+            x = _mm256_min_pd(_mm256_max_pd(x, v_min), v_max); //max returns v_min for nan lanes
+        }
+        
+        alignas(32) long long idx[4];
+        if (uniform) {
+            __m256d r = _mm256_min_pd(_mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(x, v_min), v_inv_h), v_zero), v_end);
+            r = _mm256_min_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_ceil_pd(r), v_one), v_zero), v_last);
+            __m256i seg = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(r, v_magic)), _mm256_castpd_si256(v_magic));
+            _mm256_store_si256((__m256i*)idx, seg);
+        } else {
+            //avx2 gathers are slower than the scalar binary search, so only the evaluation is vectorized here
+            //(find_segment puts inputs outside of the knots into the first/last segment like the clamped x)
+            for (size_t k = 0; k < 4; k++) {
+                idx[k] = (long long)find_segment(xs[b + k]);
+            }
+        }
+        
+        __m256d u = _mm256_sub_pd(x, _mm256_set_pd(kx[idx[3]], kx[idx[2]], kx[idx[1]], kx[idx[0]]));
+        
+        __m256d r0 = _mm256_load_pd(c + idx[0] * 4); // a0 b0 c0 d0
+        __m256d r1 = _mm256_load_pd(c + idx[1] * 4);
+        __m256d r2 = _mm256_load_pd(c + idx[2] * 4);
+        __m256d r3 = _mm256_load_pd(c + idx[3] * 4);
+        __m256d t0 = _mm256_unpacklo_pd(r0, r1); // a0 a1 c0 c1
+        __m256d t1 = _mm256_unpackhi_pd(r0, r1); // b0 b1 d0 d1
+        __m256d t2 = _mm256_unpacklo_pd(r2, r3); // a2 a3 c2 c3
+        __m256d t3 = _mm256_unpackhi_pd(r2, r3); // b2 b3 d2 d3
+        __m256d va = _mm256_permute2f128_pd(t0, t2, 0x20);
+        __m256d vb = _mm256_permute2f128_pd(t1, t3, 0x20);
+        __m256d vc = _mm256_permute2f128_pd(t0, t2, 0x31);
+        __m256d vd = _mm256_permute2f128_pd(t1, t3, 0x31);
+        
+#if defined(__FMA__)
+        __m256d y = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmadd_pd(vd, u, vc), u, vb), u, va);
+#else
+        __m256d y = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(vd, u), vc), u), vb), u), va);
+#endif
+        if (boundary == boundary_policy::extrapolate) {
+            //slope at the clamped x, x_in - x is 0 for the lanes inside the knots
+            __m256d slope = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(v_three, vd), u), _mm256_add_pd(vc, vc)), u), vb);
+            y = _mm256_add_pd(_mm256_mul_pd(slope, _mm256_sub_pd(x_in, x)), y);
+        }
+        _mm256_storeu_pd(ys + b, y);
+    }
+#else
+    (void)xs; (void)ys; (void)n;
+#endif
+    return b;
+}
 
+template<>
+size_t spline_t<float>::forward_batch_simd(const float* xs, float* ys, size_t n) const {
+    size_t b = 0;
+#if defined(__AVX512F__)
+    //16 lanes, same as the double version with 32 bit indices
+    const float x_max = knot_x.back();
+    const float* kx = knot_x.data();
+    const float* c = coeffs.data();
+    const size_t last = knot_x.size() - 2; //index of the last segment
+    const __m512 v_max = _mm512_set1_ps(x_max);
+    const __m512 v_min = _mm512_set1_ps(x_min);
+    const __m512 v_inv_h = _mm512_set1_ps(inv_h);
+    const __m512 v_zero = _mm512_setzero_ps();
+    const __m512 v_one = _mm512_set1_ps(1.0f);
+    const __m512 v_three = _mm512_set1_ps(3.0f);
+    const __m512 v_last = _mm512_set1_ps((float)last);
+    const __m512 v_end = _mm512_set1_ps((float)last + 1.0f);
+    
+    for (; b + 16 <= n; b += 16) {
+        __m512 x_in = _mm512_loadu_ps(xs + b);
+        __m512 x = x_in;
+        if (boundary == boundary_policy::error) {
+            if (_mm512_cmp_ps_mask(x, v_max, _CMP_NLE_UQ)) {
+                break; //out of range (or nan), the scalar loop reports it
+            }
+        } else {
+            x = _mm512_min_ps(_mm512_max_ps(x, v_min), v_max); //max returns v_min for nan lanes
+        }
+        
+        __m512i seg;
+        if (uniform) {
+            __m512 r = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_sub_ps(x, v_min), v_inv_h), v_zero), v_end);
+            r = _mm512_roundscale_ps(r, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+            r = _mm512_min_ps(_mm512_max_ps(_mm512_sub_ps(r, v_one), v_zero), v_last);
+            seg = _mm512_cvttps_epi32(r);
+        } else {
+            //vectorized branch light binary search, seg holds the base index of every lane
+            seg = _mm512_set1_epi32(1);
+            size_t len = knot_x.size() - 1;
+            while (len > 1) {
+                size_t half = len / 2;
+                __mmask16 lt = _mm512_cmp_ps_mask(gather_ps(seg, kx + half - 1), x, _CMP_LT_OQ);
+                seg = _mm512_mask_add_epi32(seg, lt, seg, _mm512_set1_epi32((int)half));
+                len -= half;
+            }
+            __mmask16 lt = _mm512_cmp_ps_mask(gather_ps(seg, kx), x, _CMP_LT_OQ);
+            seg = _mm512_mask_add_epi32(seg, lt, seg, _mm512_set1_epi32(1));
+            //seg is the upper knot now, x <= x_max guarantees seg - 1 <= last
+            seg = _mm512_sub_epi32(seg, _mm512_set1_epi32(1));
+        }
+        
+        __m512 u = _mm512_sub_ps(x, gather_ps(seg, kx));
+        __m512i idx = _mm512_slli_epi32(seg, 2);
+        __m512 va = gather_ps(idx, c);
+        __m512 vb = gather_ps(idx, c + 1);
+        __m512 vc = gather_ps(idx, c + 2);
+        __m512 vd = gather_ps(idx, c + 3);
+        
+        __m512 y = _mm512_fmadd_ps(_mm512_fmadd_ps(_mm512_fmadd_ps(vd, u, vc), u, vb), u, va);
+        if (boundary == boundary_policy::extrapolate) {
+            //slope at the clamped x, x_in - x is 0 for the lanes inside the knots
+            __m512 slope = _mm512_fmadd_ps(_mm512_fmadd_ps(_mm512_mul_ps(v_three, vd), u, _mm512_add_ps(vc, vc)), u, vb);
+            y = _mm512_fmadd_ps(slope, _mm512_sub_ps(x_in, x), y);
+        }
+        _mm512_storeu_ps(ys + b, y);
+    }
+#elif defined(__AVX2__)
+    //8 lanes, every segment is one 16 byte a,b,c,d row, two groups of 4 rows are transposed
+    const float x_max = knot_x.back();
+    const float* kx = knot_x.data();
+    const float* c = coeffs.data();
+    const size_t last = knot_x.size() - 2; //index of the last segment
+    const __m256 v_max = _mm256_set1_ps(x_max);
+    const __m256 v_min = _mm256_set1_ps(x_min);
+    const __m256 v_inv_h = _mm256_set1_ps(inv_h);
+    const __m256 v_zero = _mm256_setzero_ps();
+    const __m256 v_one = _mm256_set1_ps(1.0f);
+    const __m256 v_three = _mm256_set1_ps(3.0f);
+    const __m256 v_last = _mm256_set1_ps((float)last);
+    const __m256 v_end = _mm256_set1_ps((float)last + 1.0f);
+    
+    for (; b + 8 <= n; b += 8) {
+        __m256 x_in = _mm256_loadu_ps(xs + b);
+        __m256 x = x_in;
+        if (boundary == boundary_policy::error) {
+            if (_mm256_movemask_ps(_mm256_cmp_ps(x, v_max, _CMP_NLE_UQ))) {
+                break; //out of range (or nan), the scalar loop reports it
+            }
+        } else {
+            x = _mm256_min_ps(_mm256_max_ps(x, v_min), v_max); //max returns v_min for nan lanes
+        }
+        
+        alignas(32) int idx[8];
+        if (uniform) {
+            __m256 r = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(x, v_min), v_inv_h), v_zero), v_end);
+            r = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_ceil_ps(r), v_one), v_zero), v_last);
+            _mm256_store_si256((__m256i*)idx, _mm256_cvttps_epi32(r));
+        } else {
+            //avx2 gathers are slower than the scalar binary search, so only the evaluation is vectorized here
+            //(find_segment puts inputs outside of the knots into the first/last segment like the clamped x)
+            for (size_t k = 0; k < 8; k++) {
+                idx[k] = (int)find_segment(xs[b + k]);
+            }
+        }
+        
+        alignas(32) float x_seg[8];
+        for (size_t k = 0; k < 8; k++) {
+            x_seg[k] = kx[idx[k]];
+        }
+        __m256 u = _mm256_sub_ps(x, _mm256_load_ps(x_seg));
+        
+        __m128 r0 = _mm_load_ps(c + idx[0] * 4), r1 = _mm_load_ps(c + idx[1] * 4); // a b c d rows
+        __m128 r2 = _mm_load_ps(c + idx[2] * 4), r3 = _mm_load_ps(c + idx[3] * 4);
+        __m128 r4 = _mm_load_ps(c + idx[4] * 4), r5 = _mm_load_ps(c + idx[5] * 4);
+        __m128 r6 = _mm_load_ps(c + idx[6] * 4), r7 = _mm_load_ps(c + idx[7] * 4);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3); // r0 = a0..a3, r1 = b0..b3, ...
+        _MM_TRANSPOSE4_PS(r4, r5, r6, r7);
+        __m256 va = _mm256_set_m128(r4, r0);
+        __m256 vb = _mm256_set_m128(r5, r1);
+        __m256 vc = _mm256_set_m128(r6, r2);
+        __m256 vd = _mm256_set_m128(r7, r3);
+        
+#if defined(__FMA__)
+        __m256 y = _mm256_fmadd_ps(_mm256_fmadd_ps(_mm256_fmadd_ps(vd, u, vc), u, vb), u, va);
+#else
+        __m256 y = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(vd, u), vc), u), vb), u), va);
+#endif
+        if (boundary == boundary_policy::extrapolate) {
+            //slope at the clamped x, x_in - x is 0 for the lanes inside the knots
+            __m256 slope = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(v_three, vd), u), _mm256_add_ps(vc, vc)), u), vb);
+            y = _mm256_add_ps(_mm256_mul_ps(slope, _mm256_sub_ps(x_in, x)), y);
+        }
+        _mm256_storeu_ps(ys + b, y);
+    }
+#else
+    (void)xs; (void)ys; (void)n;
+#endif
+    return b;
+}
+
+#if defined(__AVX512F__) && defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+template<typename T>
+void spline_t<T>::forward_batch(const T* xs, T* ys, size_t n) const {
+    if (knot_x.empty() || coeffs.empty()) {
+        throw std::runtime_error("No points or parameters defined for spline.");
+    }
+    
+    //vectorized part (AVX2/AVX-512 if enabled), the scalar loop does the rest
+    size_t b = forward_batch_simd(xs, ys, n);
+    
+    for (; b < n; b++) {
+        T xb = bound_input(xs[b]);
+        ys[b] = evaluate_segment(find_segment(xb), xb, xs[b]);
+    }
+}
+
+template<typename T>
+void spline_t<T>::forward_batch(std::span<const T> xs, std::span<T> ys) const {
+    if (xs.size() != ys.size()) {
+        throw std::invalid_argument("forward_batch: xs and ys must have the same size.");
+    }
+    forward_batch(xs.data(), ys.data(), xs.size());
 }
 //x =input from forward,y_d output from prev layer or error func,y= expected targed value,lr =learning rate
-double spline::backward(double x, double d_y, double y) {
+template<typename T>
+T spline_t<T>::backward(T x, T d_y, T y) {
     //std::cout<<"backward in spline\n";
     //check for empty points and parameters
-    if (points.empty() || params.empty()) {
+    if (knot_x.empty() || coeffs.empty()) {
         throw std::runtime_error("No points or parameters defined for spline.");
     }
     
-    //find segment of x
-    size_t i;
-    for (i = 1; i < points.size(); i++) {
-
-        if (x <= points[i][0]) {
-            break; //exit if segment index is found
-        }
-    }
-/*debug
-    std::cout<<"\nin spline backwards x="<<x<<" founf point indx:"<<i<<"\n";
-*/
-    double d_E = (forward(x)-y)+d_y; //respective error of current layer + accumulated grad
+    //forward_segment also checks the bounds and gives the segment and offset for the grad
+    uint32_t segment;
+    T offset;
+    T d_E = (forward_segment(x, segment, offset)-y)+d_y; //respective error of current layer + accumulated grad
 /*debug
     std::cout<<"dy: "<<d_y<<"D_E in spline="<<d_E<<"\n";
 */
-    grad[i] += d_E;
-    /*
-    points[i][1] = points[i][1]+lr*d_E; //Adjust y_i based on error grad
-    //update spline
-    interpolation(); //done still experimental
-    */
+    accumulate_grad(segment, offset, d_E);
+    
     return d_E; //return error grad for backwards pass into next layer
 }
 
-void spline::apply_grad(double lr) {
+template<typename T>
+void spline_t<T>::apply_grad(T lr, bool interpolate) {
+    size_t first = grad.size(), last = 0; //range of the changed points
     for (size_t i = 0; i < grad.size(); i++ ) {
-        if (grad[i] != 0.0) {
-            points[i][1] = points[i][1]-lr*grad[i]; //Adjust y_i based on error grad
-            grad[i] = 0.0; //reset grad for next bwd 
+        if (grad[i] != T(0)) {
+            knot_y[i] = knot_y[i]-lr*grad[i]; //Adjust y_i based on error grad
+            grad[i] = T(0); //reset grad for next bwd 
+            first = std::min(first, i);
+            last = i;
         }
     }
+    if (!interpolate) {
+        return;
+    }
+    if (kind == spline_kind::bspline) {
+        //control point k is used by the segments k-2 .. k+1
+        if (first <= last) {
+            size_t last_segment = knot_x.size() - 2;
+            update_bspline_segments((first > 2) ? first - 2 : 0, std::min(last + 1, last_segment));
+        }
+        return;
+    }
     this->interpolation();
 }
 
-std::vector<std::vector<double>> spline::get_points(){
+template<typename T>
+std::vector<std::vector<T>> spline_t<T>::get_points() const {
+    std::vector<std::vector<T>> points(knot_x.size(), std::vector<T>(2));
+    for (size_t i = 0; i < knot_x.size(); i++) {
+        points[i][0] = knot_x[i];
+        points[i][1] = knot_y[i];
+    }
     return points;
 }
 
-std::vector<std::vector<double>> spline::get_params(){
+template<typename T>
+std::vector<std::vector<T>> spline_t<T>::get_params() const {
+    std::vector<std::vector<T>> params(coeffs.size() / 4, std::vector<T>(4));
+    for (size_t i = 0; i < params.size(); i++) {
+        for (size_t k = 0; k < 4; k++) {
+            params[i][k] = coeffs[i * 4 + k];
+        }
+    }
     return params;
 }
 
-}//namespace
+template struct spline_factorization_t<float>;
+template struct spline_factorization_t<double>;
+template class spline_t<float>;
+template class spline_t<double>;
 
-//adding this line to force run the new tests without making meaningfull changes to the code (ummay delete this later)
\ No newline at end of file
+}//namespace
@@ -0,0 +1,160 @@
+// Copyright (c) <2024>, <Tobias Karusseit>
+//
+// This file is part of the PySplineNetLib project, which is licensed under the
+// Mozilla Public License, Version 2.0 (MPL-2.0).
+//
+// SPDX-License-Identifier: MPL-2.0
+// For the full text of the licenses, see:
+// - Mozilla Public License 2.0: https://opensource.org/licenses/MPL-2.0
+
+
+#include "../include/SplineNetLib/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace SplineNetLib {
+
+thread_pool::thread_pool(unsigned int num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(num_threads);
+    for (unsigned int i = 0; i < num_threads; i++) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        stopping = true;
+    }
+    tasks_cv.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void thread_pool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasks_mutex);
+            tasks_cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return; //stopping and nothing left to do
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        //submit passes exceptions through its future, an enqueued task has no caller left so its exception is dropped
+        //instead of terminating the process (parallel_for catches in its chunks itself)
+        try {
+            task();
+        } catch (...) {
+        }
+    }
+}
+
+void thread_pool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        tasks.push_back(std::move(task));
+    }
+    tasks_cv.notify_one();
+}
+
+void thread_pool::parallel_for(size_t n, size_t grain, const std::function<void(size_t, size_t)> &body) {
+    if (n == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t num_chunks = (n + grain - 1) / grain;
+    if (num_chunks == 1 || workers.size() <= 1) {
+        body(0, n);
+        return;
+    }
+
+    //shared with the helpers, a helper that starts after all chunks were taken just returns
+    struct state_t {
+        std::atomic<size_t> next_chunk{0};
+        size_t done_chunks = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done_cv;
+    };
+    std::shared_ptr<state_t> state = std::make_shared<state_t>();
+
+    //body is only used while chunks are left, so the caller (that waits for all chunks) keeps it alive
+    auto run_chunks = [state, n, grain, num_chunks, &body]() {
+        size_t chunk;
+        while ((chunk = state->next_chunk.fetch_add(1)) < num_chunks) {
+            std::exception_ptr error;
+            try {
+                size_t begin = chunk * grain;
+                body(begin, std::min(begin + grain, n));
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (error && !state->error) {
+                state->error = error;
+            }
+            if (++state->done_chunks == num_chunks) {
+                state->done_cv.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(num_chunks - 1, workers.size());
+    for (size_t h = 0; h < helpers; h++) {
+        enqueue(run_chunks);
+    }
+    run_chunks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done_cv.wait(lock, [&]() { return state->done_chunks == num_chunks; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+namespace {
+    std::mutex default_pool_mutex;
+    std::unique_ptr<thread_pool> default_pool_instance;
+    unsigned int default_pool_threads = 0; //0 = hardware_concurrency
+}
+
+thread_pool& default_pool() {
+    std::lock_guard<std::mutex> lock(default_pool_mutex);
+    if (!default_pool_instance) {
+        default_pool_instance = std::make_unique<thread_pool>(default_pool_threads);
+    }
+    return *default_pool_instance;
+}
+
+void set_num_threads(unsigned int num_threads) {
+    {
+        std::lock_guard<std::mutex> lock(default_pool_mutex);
+        default_pool_threads = num_threads;
+    }
+    reset_default_pool(); //recreated with the new size on the next use
+}
+
+unsigned int get_num_threads() {
+    return default_pool().size();
+}
+
+void reset_default_pool() {
+    std::unique_ptr<thread_pool> old;
+    {
+        std::lock_guard<std::mutex> lock(default_pool_mutex);
+        old = std::move(default_pool_instance);
+    }
+    //joined without the lock, a queued task that calls default_pool() would deadlock otherwise
+    old.reset();
+}
+
+}//namespace
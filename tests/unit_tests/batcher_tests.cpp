@@ -0,0 +1,74 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <thread>
+
+#include "../include/SplineNetLib/batcher.hpp"
+#include "test_networks.hpp"
+
+using namespace SplineNetLib;
+
+TEST_CASE("batcher coalesces concurrent requests") {
+    nn network(2, {3, 5}, {5, 2}, {5, 6}, {1.0, 1.0}, spline_kind::natural, boundary_policy::clamp);
+    train_a_little(network);
+    inference_batcher batcher(network, true, 16, std::chrono::milliseconds(20));
+    REQUIRE(batcher.max_batch_size() == 16);
+    
+    //64 requests submitted at once fit into a few batches
+    std::vector<std::vector<double>> x;
+    std::vector<std::future<std::vector<double>>> results;
+    for (int b = 0; b < 64; b++) {
+        x.push_back({0.015 * b, 1.0 - 0.01 * b, 0.5});
+        results.push_back(batcher.submit(x.back()));
+    }
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> pred = results[b].get(), expected = network.forward(x[b], true);
+        for (size_t j = 0; j < 2; j++) {
+            REQUIRE(pred[j] == Catch::Approx(expected[j]));
+        }
+    }
+    REQUIRE(batcher.num_samples() == 64);
+    REQUIRE(batcher.num_batches() < 64);
+    REQUIRE(batcher.num_batches() >= 4);
+}
+
+TEST_CASE("batcher serves requests from many threads") {
+    nn network(2, {3, 5}, {5, 2}, {5, 6}, {1.0, 1.0}, spline_kind::natural, boundary_policy::clamp);
+    train_a_little(network);
+    inference_batcher batcher(network, false, 8, std::chrono::microseconds(200));
+    std::vector<std::vector<std::vector<double>>> pred(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < pred.size(); t++) {
+        threads.emplace_back([&, t]() {
+            for (int b = 0; b < 50; b++) {
+                pred[t].push_back(batcher.forward({0.02 * b, 0.1 * t, 0.5}));
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 0; t < pred.size(); t++) {
+        for (int b = 0; b < 50; b++) {
+            std::vector<double> expected = network.forward({0.02 * b, 0.1 * t, 0.5}, false);
+            for (size_t j = 0; j < 2; j++) {
+                REQUIRE(pred[t][b][j] == Catch::Approx(expected[j]));
+            }
+        }
+    }
+    REQUIRE(batcher.num_samples() == 200);
+}
+
+TEST_CASE("batcher fails only the bad request") {
+    nn network(2, {3, 5}, {5, 2}, {5, 6}, {1.0, 1.0});
+    train_a_little(network);
+    inference_batcher batcher(network, true, 4, std::chrono::milliseconds(50));
+    REQUIRE_THROWS_AS(batcher.submit({0.5}), std::invalid_argument);
+    
+    std::future<std::vector<double>> good = batcher.submit({0.1, 0.2, 0.3});
+    std::future<std::vector<double>> bad = batcher.submit({0.1, 2.0, 0.3});
+    std::future<std::vector<double>> other = batcher.submit({0.4, 0.5, 0.6});
+    REQUIRE(good.get().size() == 2);
+    REQUIRE_THROWS_AS(bad.get(), std::runtime_error);
+    REQUIRE(other.get().size() == 2);
+}
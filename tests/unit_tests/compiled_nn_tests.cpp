@@ -0,0 +1,73 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <thread>
+
+#include "../include/SplineNetLib/compiled_nn.hpp"
+#include "test_networks.hpp"
+
+using namespace SplineNetLib;
+
+TEST_CASE("compiled network matches nn forward") {
+    for (spline_kind kind : {spline_kind::natural, spline_kind::bspline}) {
+        nn network(3, {3, 5, 4}, {5, 4, 2}, {6, 4, 5}, {1.0, 1.0, 1.0}, kind, boundary_policy::clamp);
+        train_a_little(network);
+        std::vector<std::vector<double>> x = {{0.1, 0.3, 0.5}, {0.75, 0.5, 0.0}, {1.0, 0.05, 0.9}, {-0.5, 1.5, 0.2}};
+        for (bool normalize : {true, false}) {
+            compiled_nn compiled = network.compile(normalize);
+            REQUIRE(compiled.normalizes() == normalize);
+            REQUIRE(compiled.num_layers() == 3);
+            REQUIRE(compiled.input_size() == 3);
+            REQUIRE(compiled.output_size() == 2);
+            std::vector<std::vector<double>> batch = compiled.forward(x);
+            for (size_t b = 0; b < x.size(); b++) {
+                std::vector<double> expected = network.forward(x[b], normalize), pred = compiled.forward(x[b]);
+                for (size_t j = 0; j < 2; j++) {
+                    REQUIRE(pred[j] == Catch::Approx(expected[j]));
+                    REQUIRE(batch[b][j] == Catch::Approx(expected[j]));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("compiled network keeps the boundary policy and checks sizes") {
+    nn network(2, {2, 3}, {3, 2}, {5, 5}, {1.0, 1.0});
+    train_a_little(network);
+    compiled_nn compiled = network.compile(true);
+    REQUIRE_THROWS_AS(compiled.forward(std::vector<double>{0.5, 2.0}), std::runtime_error);
+    
+    std::vector<double> out(2), workspace(compiled.workspace_size() - 1);
+    REQUIRE_THROWS_AS(compiled.forward_into(std::vector<double>{0.5}, out), std::invalid_argument);
+    REQUIRE_THROWS_AS(compiled.forward_into(std::vector<double>{0.5, 0.5}, out, workspace), std::invalid_argument);
+}
+
+TEST_CASE("one compiled network can be used by several threads") {
+    nn network(2, {3, 4}, {4, 2}, {5, 6}, {1.0, 1.0}, spline_kind::natural, boundary_policy::extrapolate);
+    train_a_little(network);
+    const compiled_nn compiled = network.compile(true);
+    
+    std::vector<std::vector<double>> x;
+    for (int b = 0; b < 64; b++) {
+        x.push_back({0.01 * b, 1.0 - 0.01 * b, 0.02 * b - 0.3});
+    }
+    std::vector<std::vector<double>> expected = compiled.forward(x);
+    std::vector<std::vector<std::vector<double>>> results(4, std::vector<std::vector<double>>(x.size()));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < results.size(); t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t b = 0; b < x.size(); b++) {
+                results[t][b] = compiled.forward(x[b]);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (const auto &result : results) {
+        REQUIRE(result == expected);
+    }
+    
+    std::future<std::vector<double>> async = compiled.forward_async(x[3]);
+    REQUIRE(async.get() == expected[3]);
+}
@@ -0,0 +1,51 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include "../include/SplineNetLib/fixed_layer.hpp"
+
+using namespace SplineNetLib;
+
+TEST_CASE("fixed spline matches the runtime spline") {
+    std::vector<std::vector<double>> points = {{0.0, 0.0}, {0.1, 1.0}, {0.35, 2.5}, {0.6, 2.0}, {0.7, 2.0}, {1.0, 0.5}};
+    for (spline_kind kind : {spline_kind::natural, spline_kind::bspline}) {
+        spline s(points, std::vector<std::vector<double>>(5, std::vector<double>(4, 0.0)), kind);
+        s.interpolation();
+        
+        fixed_spline<4> fixed(s);
+        REQUIRE(fixed.get_kind() == kind);
+        fixed_spline<4> reinterpolated(s);
+        reinterpolated.interpolation();
+        for (double x : {0.0, 0.05, 0.1, 0.2, 0.35, 0.5, 0.65, 0.7, 0.9, 1.0, -0.2}) {
+            REQUIRE(fixed.forward(x) == Catch::Approx(s.forward(x)));
+            REQUIRE(reinterpolated.forward(x) == Catch::Approx(s.forward(x)));
+        }
+        REQUIRE_THROWS_AS(fixed.forward(1.5), std::runtime_error);
+        
+        s.set_boundary(boundary_policy::extrapolate);
+        fixed.set_boundary(boundary_policy::extrapolate);
+        for (double x : {-0.5, 1.5, 3.0}) {
+            REQUIRE(fixed.forward(x) == Catch::Approx(s.forward(x)));
+        }
+    }
+    spline other(std::vector<std::vector<double>>(4, {0.0, 0.0}), std::vector<std::vector<double>>(3, std::vector<double>(4, 0.0)));
+    REQUIRE_THROWS_AS(fixed_spline<4>(other), std::invalid_argument);
+}
+
+TEST_CASE("fixed layer built from a trained layer matches it") {
+    layer l(4, 5, 6, 1.0, spline_kind::natural, boundary_policy::clamp);
+    for (int step = 0; step < 3; step++) {
+        l.backward({0.1 * step, 0.5, 0.9 - 0.2 * step, 0.33}, {1.0, -0.5, 0.25, 2.0, -1.0});
+    }
+    REQUIRE_THROWS_AS(fixed_layer<5>(l), std::invalid_argument);
+    
+    fixed_layer<6> fixed(l);
+    REQUIRE(fixed.input_size() == 4);
+    REQUIRE(fixed.output_size() == 5);
+    std::vector<std::vector<double>> x = {{0.0, 0.2, 0.4, 0.6}, {0.95, 0.05, 0.5, 1.0}, {-1.0, 0.3, 2.0, 0.7}};
+    std::vector<std::vector<double>> expected = l.forward(x, true), pred = fixed.forward(x, true);
+    for (size_t b = 0; b < x.size(); b++) {
+        for (size_t j = 0; j < 5; j++) {
+            REQUIRE(pred[b][j] == Catch::Approx(expected[b][j]));
+        }
+    }
+}
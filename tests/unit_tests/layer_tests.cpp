@@ -1,11 +1,392 @@
-#define CATCH_CONFIG_MAIN
-#include "catch2/catch.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
 
 #include "../include/SplineNetLib/layers.hpp"
 
-using namespace SplineNetLib ;
+using namespace SplineNetLib;
 
 //test initialization
-TEST_CASE("layer initialization using constructor method functions as expected") {}
+TEST_CASE("layer initialization using constructor method functions as expected") {
+    layer Test_layer(3, 2, 6, 1.0);
+    std::vector<std::vector<spline>> splines = Test_layer.get_splines();
     
-}
\ No newline at end of file
+    REQUIRE(splines.size() == 3);
+    REQUIRE(splines[0].size() == 2);
+    REQUIRE(splines[0][0].get_points().size() == 8);
+    REQUIRE(splines[0][0].get_params().size() == 7);
+}
+
+TEST_CASE("layer batched forward matches the single sample forward") {
+    std::vector<std::vector<std::vector<std::vector<double>>>> points = {
+        {{{0.0,1.0},{0.5,2.0},{1.0,3.0}}, {{0.0,0.1},{0.5,0.2},{1.0,0.4}}},
+        {{{0.0,1.0},{0.5,2.0},{1.0,4.0}}, {{0.0,0.1},{0.3,0.2},{1.0,0.3}}}
+    };
+    std::vector<std::vector<std::vector<std::vector<double>>>> params(2, std::vector<std::vector<std::vector<double>>>(
+                                                                       2, std::vector<std::vector<double>>(
+                                                                       2, std::vector<double>(4, 0.0))));
+    layer Test_layer(points, params);
+    Test_layer.interpolate_splines();
+    
+    std::vector<std::vector<double>> x = {{0.0, 0.1}, {0.25, 0.5}, {0.5, 0.75}, {0.9, 1.0}, {1.0, 0.3}};
+    for (bool normalize : {false, true}) {
+        std::vector<std::vector<double>> batch_pred = Test_layer.forward(x, normalize);
+        REQUIRE(batch_pred.size() == x.size());
+        for (size_t b = 0; b < x.size(); b++) {
+            std::vector<double> pred = Test_layer.forward(x[b], normalize);
+            for (size_t j = 0; j < pred.size(); j++) {
+                REQUIRE(batch_pred[b][j] == Catch::Approx(pred[j]));
+            }
+        }
+    }
+}
+
+TEST_CASE("layer bulk interpolation matches interpolating every spline on its own") {
+    layer Test_layer(3, 4, 6, 1.0);
+    Test_layer.interpolate_splines();
+    //train a little so the splines have different y values
+    for (int step = 0; step < 5; step++) {
+        Test_layer.backward({0.1 * step, 0.9 - 0.1 * step, 0.5}, {1.0, -2.0, 0.5, 3.0});
+    }
+    Test_layer.interpolate_splines();
+    
+    for (auto& row : Test_layer.get_splines()) {
+        for (auto& bulk : row) {
+            spline single(bulk.get_points(), bulk.get_params());
+            single.interpolation();
+            std::vector<std::vector<double>> expected = single.get_params(), actual = bulk.get_params();
+            for (size_t i = 0; i < expected.size(); i++) {
+                for (size_t k = 0; k < 4; k++) {
+                    REQUIRE(actual[i][k] == Catch::Approx(expected[i][k]).margin(1e-12));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("layer backward with a training tape matches the recomputing backward") {
+    layer taped(3, 2, 6, 1.0), recomputed(3, 2, 6, 1.0);
+    taped.interpolate_splines();
+    recomputed.interpolate_splines();
+    taped.training = true;
+    
+    std::vector<std::vector<double>> x = {{0.1, 0.9, 0.5}, {0.7, 0.2, 0.3}, {0.4, 0.4, 1.0}};
+    std::vector<std::vector<double>> d_y = {{1.0, -2.0}, {0.5, 3.0}, {-1.0, 0.25}};
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> taped_pred = taped.forward(x[b], false);
+        std::vector<double> recomputed_pred = recomputed.forward(x[b], false);
+        std::vector<double> taped_grad = taped.backward(x[b], d_y[b]);
+        std::vector<double> recomputed_grad = recomputed.backward(x[b], d_y[b]);
+        for (size_t j = 0; j < taped_pred.size(); j++) {
+            REQUIRE(taped_pred[j] == recomputed_pred[j]);
+        }
+        for (size_t i = 0; i < taped_grad.size(); i++) {
+            REQUIRE(taped_grad[i] == Catch::Approx(recomputed_grad[i]));
+        }
+    }
+    
+    std::vector<std::vector<spline>> taped_splines = taped.get_splines(), recomputed_splines = recomputed.get_splines();
+    for (size_t i = 0; i < taped_splines.size(); i++) {
+        for (size_t j = 0; j < taped_splines[i].size(); j++) {
+            std::vector<std::vector<double>> expected = recomputed_splines[i][j].get_points(), actual = taped_splines[i][j].get_points();
+            for (size_t k = 0; k < expected.size(); k++) {
+                REQUIRE(actual[k][1] == Catch::Approx(expected[k][1]));
+            }
+        }
+    }
+}
+
+TEST_CASE("layer batch backward accumulates the batch and applies it in one step") {
+    layer batched(3, 2, 6, 1.0), stepped(3, 2, 6, 1.0), summed(3, 2, 6, 1.0);
+    std::vector<std::vector<double>> x = {{0.1, 0.9, 0.5}, {0.7, 0.2, 0.3}, {0.4, 0.4, 1.0}};
+    std::vector<std::vector<double>> d_y = {{1.0, -2.0}, {0.5, 3.0}, {-1.0, 0.25}};
+    for (layer* l : {&batched, &stepped, &summed}) {
+        l->interpolate_splines();
+        l->forward(x, false);
+    }
+    batched.training = true; //batch backward gives the same result with and without tape
+    batched.forward(x, false);
+    
+    batched.backward(x, d_y);
+    for (size_t b = 0; b < x.size(); b++) {
+        stepped.backward(x[b], d_y[b], false);
+    }
+    stepped.step();
+    //mean reduction == sum reduction with lr / batch size
+    summed.reduction = grad_reduction::sum;
+    summed.lr = summed.lr / x.size();
+    summed.backward(x, d_y);
+    
+    std::vector<std::vector<spline>> expected = stepped.get_splines();
+    for (layer* l : {&batched, &summed}) {
+        std::vector<std::vector<spline>> actual = l->get_splines();
+        for (size_t i = 0; i < expected.size(); i++) {
+            for (size_t j = 0; j < expected[i].size(); j++) {
+                std::vector<std::vector<double>> e = expected[i][j].get_params(), a = actual[i][j].get_params();
+                for (size_t k = 0; k < e.size(); k++) {
+                    for (size_t c = 0; c < 4; c++) {
+                        REQUIRE(a[k][c] == Catch::Approx(e[k][c]).margin(1e-12));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("layer forward checks the input size with and without training") {
+    layer Test_layer(3, 2, 6, 1.0);
+    Test_layer.interpolate_splines();
+    for (bool training : {false, true}) {
+        Test_layer.training = training;
+        REQUIRE_THROWS_AS(Test_layer.forward(std::vector<double>{0.5}, false), std::invalid_argument);
+        REQUIRE_THROWS_AS(Test_layer.forward(std::vector<std::vector<double>>{{0.5, 0.5, 0.5}, {0.5}}, false), std::invalid_argument);
+    }
+}
+
+TEST_CASE("layer forward_into matches forward") {
+    layer Test_layer(3, 4, 6, 1.0);
+    Test_layer.interpolate_splines();
+    Test_layer.backward({0.1, 0.9, 0.5}, {1.0, -2.0, 0.5, 3.0});
+    
+    std::vector<double> x = {0.3, 0.6, 0.95}, out(4);
+    for (bool normalize : {false, true}) {
+        std::vector<double> expected = Test_layer.forward(x, normalize);
+        Test_layer.forward_into(x, out, normalize);
+        for (size_t j = 0; j < out.size(); j++) {
+            REQUIRE(out[j] == expected[j]);
+        }
+    }
+    std::vector<double> too_small(3);
+    REQUIRE_THROWS(Test_layer.forward_into(x, too_small, false));
+}
+
+TEST_CASE("layer shared knot kernel matches evaluating every spline") {
+    layer Test_layer(3, 12, 6, 1.0);
+    Test_layer.interpolate_splines();
+    Test_layer.backward({0.1, 0.9, 0.5}, std::vector<double>(12, -1.5));
+    Test_layer.backward({0.6, 0.3, 0.05}, {1.0, -2.0, 0.5, 3.0, 1.0, 0.0, 0.25, -1.0, 2.0, 0.5, -0.5, 1.5});
+    std::vector<std::vector<spline>> splines = Test_layer.get_splines();
+    
+    std::vector<std::vector<double>> x = {{0.0, 0.1, 0.2}, {0.33, 0.5, 0.75}, {0.9, 1.0, 0.45}};
+    std::vector<std::vector<double>> batch_pred = Test_layer.forward(x, false);
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> pred = Test_layer.forward(x[b], false);
+        for (size_t j = 0; j < 12; j++) {
+            double expected = 0.0;
+            for (size_t i = 0; i < 3; i++) {
+                expected += splines[i][j].forward(x[b][i]);
+            }
+            REQUIRE(pred[j] == Catch::Approx(expected));
+            REQUIRE(batch_pred[b][j] == Catch::Approx(expected));
+        }
+    }
+    REQUIRE_THROWS(Test_layer.forward(std::vector<double>{0.5, 1.5, 0.5}, false));
+}
+
+TEST_CASE("layer parallel batch forward matches the single sample forward") {
+    layer Test_layer(4, 3, 6, 1.0);
+    Test_layer.interpolate_splines();
+    Test_layer.backward({0.1, 0.9, 0.5, 0.2}, {1.0, -2.0, 0.5});
+    Test_layer.grain = 3; //many chunks
+    set_num_threads(4);
+    
+    std::vector<std::vector<double>> x(50, std::vector<double>(4));
+    for (size_t b = 0; b < x.size(); b++) {
+        for (size_t i = 0; i < 4; i++) {
+            x[b][i] = (double)((b * 7 + i * 3) % 50) / 49.0;
+        }
+    }
+    std::vector<std::vector<double>> batch_pred = Test_layer.forward(x, true);
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> pred = Test_layer.forward(x[b], true);
+        for (size_t j = 0; j < pred.size(); j++) {
+            REQUIRE(batch_pred[b][j] == Catch::Approx(pred[j]));
+        }
+    }
+    x[31][2] = 2.0;
+    REQUIRE_THROWS(Test_layer.forward(x, false));
+    set_num_threads(0);
+}
+
+TEST_CASE("layer parallel batch backward matches the serial batch backward") {
+    std::vector<std::vector<double>> x(40, std::vector<double>(3)), d_y(40, std::vector<double>(5));
+    for (size_t b = 0; b < x.size(); b++) {
+        for (size_t i = 0; i < 3; i++) {
+            x[b][i] = (double)((b * 11 + i * 5) % 40) / 39.0;
+        }
+        for (size_t j = 0; j < 5; j++) {
+            d_y[b][j] = (double)((b + j) % 7) - 3.0;
+        }
+    }
+    
+    std::vector<std::vector<std::vector<double>>> params;
+    std::vector<std::vector<std::vector<double>>> propagated;
+    //serial, parallel on 3 threads, parallel without threads
+    for (unsigned int threads : {0u, 3u, 1u}) {
+        bool use_parallel = threads != 0;
+        set_num_threads(use_parallel ? threads : 0);
+        for (bool taped : {false, true}) {
+            layer Test_layer(3, 5, 6, 1.0);
+            Test_layer.interpolate_splines();
+            Test_layer.grain = 7;
+            Test_layer.training = taped;
+            Test_layer.forward(x, false);
+            
+            parallel = use_parallel;
+            propagated.push_back(Test_layer.backward(x, d_y));
+            parallel = false;
+            
+            params.emplace_back();
+            for (auto& row : Test_layer.get_splines()) {
+                for (auto& s : row) {
+                    for (auto& p : s.get_params()) {
+                        params.back().push_back(p);
+                    }
+                }
+            }
+        }
+    }
+    for (size_t r = 1; r < params.size(); r++) {
+        for (size_t k = 0; k < params[0].size(); k++) {
+            for (size_t c = 0; c < 4; c++) {
+                REQUIRE(params[r][k][c] == Catch::Approx(params[0][k][c]).margin(1e-12));
+            }
+        }
+        for (size_t b = 0; b < x.size(); b++) {
+            for (size_t i = 0; i < 3; i++) {
+                REQUIRE(propagated[r][b][i] == Catch::Approx(propagated[0][b][i]));
+            }
+        }
+    }
+    set_num_threads(0);
+    //the parallel result does not depend on the number of threads
+    REQUIRE(params[2] == params[4]);
+    REQUIRE(params[3] == params[5]);
+}
+
+TEST_CASE("layer split across input rows matches the unsplit layer") {
+    set_num_threads(4);
+    layer split(9, 6, 5, 1.0), whole(9, 6, 5, 1.0);
+    split.row_grain = 2;
+    for (layer* l : {&split, &whole}) {
+        l->interpolate_splines();
+    }
+    
+    for (bool taped : {false, true}) {
+        for (int step = 0; step < 3; step++) {
+            std::vector<double> x(9), d_y(6);
+            for (size_t i = 0; i < 9; i++) {
+                x[i] = (double)((i * 5 + step * 3) % 9) / 8.0;
+            }
+            for (size_t j = 0; j < 6; j++) {
+                d_y[j] = (double)((j + step) % 4) - 1.5;
+            }
+            split.training = whole.training = taped;
+            std::vector<double> split_pred = split.forward(x, true), whole_pred = whole.forward(x, true);
+            for (size_t j = 0; j < 6; j++) {
+                REQUIRE(split_pred[j] == Catch::Approx(whole_pred[j]));
+            }
+            std::vector<double> split_grad = split.backward(x, d_y), whole_grad = whole.backward(x, d_y);
+            for (size_t i = 0; i < 9; i++) {
+                REQUIRE(split_grad[i] == Catch::Approx(whole_grad[i]));
+            }
+        }
+    }
+    split.interpolate_splines();
+    whole.interpolate_splines();
+    
+    std::vector<double> x = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9}, split_out(6), whole_out(6);
+    split.forward_into(x, split_out, false);
+    whole.forward_into(x, whole_out, false);
+    for (size_t j = 0; j < 6; j++) {
+        REQUIRE(split_out[j] == Catch::Approx(whole_out[j]));
+    }
+    set_num_threads(0);
+}
+
+TEST_CASE("b-spline layer trains with the same grads on the taped, recomputing and parallel paths") {
+    set_num_threads(4);
+    layer taped(3, 4, 6, 1.0, spline_kind::bspline), recomputed(3, 4, 6, 1.0, spline_kind::bspline), batched(3, 4, 6, 1.0, spline_kind::bspline);
+    REQUIRE(batched.get_kind() == spline_kind::bspline);
+    taped.training = true;
+    
+    std::vector<std::vector<double>> x, d_y;
+    for (size_t b = 0; b < 5; b++) {
+        x.push_back({(double)b / 5.0, (double)(b * 3 % 5) / 5.0, 0.9 - (double)b / 10.0});
+        d_y.push_back({1.0, -0.5, (double)b / 4.0, -1.0});
+    }
+    for (size_t b = 0; b < x.size(); b++) {
+        taped.forward(x[b], false);
+        std::vector<double> taped_grad = taped.backward(x[b], d_y[b]);
+        std::vector<double> recomputed_grad = recomputed.backward(x[b], d_y[b]);
+        for (size_t i = 0; i < 3; i++) {
+            REQUIRE(taped_grad[i] == Catch::Approx(recomputed_grad[i]));
+        }
+    }
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            REQUIRE(taped.get_splines()[i][j].get_points() == recomputed.get_splines()[i][j].get_points());
+        }
+    }
+    
+    //one batch on the data parallel path matches accumulating the samples one by one
+    layer serial(3, 4, 6, 1.0, spline_kind::bspline);
+    for (size_t b = 0; b < x.size(); b++) {
+        serial.backward(x[b], d_y[b], false);
+    }
+    serial.step();
+    parallel = true;
+    batched.grain = 2;
+    batched.backward(x, d_y);
+    parallel = false;
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            std::vector<std::vector<double>> a = serial.get_splines()[i][j].get_params(), b = batched.get_splines()[i][j].get_params();
+            for (size_t s = 0; s < a.size(); s++) {
+                for (size_t k = 0; k < 4; k++) {
+                    REQUIRE(a[s][k] == Catch::Approx(b[s][k]).margin(1e-12));
+                }
+            }
+        }
+    }
+    std::vector<double> serial_out(4), batched_out(4);
+    serial.forward_into(x[1], serial_out, false);
+    batched.forward_into(x[1], batched_out, false);
+    for (size_t j = 0; j < 4; j++) {
+        REQUIRE(serial_out[j] == Catch::Approx(batched_out[j]));
+        REQUIRE(serial_out[j] != 0.0);
+    }
+    set_num_threads(0);
+}
+
+TEST_CASE("layer boundary policy keeps out of range inputs from throwing") {
+    layer clamped(3, 9, 5, 1.0, spline_kind::natural, boundary_policy::clamp);
+    layer reference(3, 9, 5, 1.0);
+    REQUIRE(clamped.get_boundary() == boundary_policy::clamp);
+    for (layer* l : {&clamped, &reference}) {
+        l->training = true;
+        l->forward({0.2, 0.5, 0.9}, false);
+        l->backward({0.2, 0.5, 0.9}, {1.0, -1.0, 0.5, 0.2, -0.3, 0.7, 1.0, 0.1, -0.4});
+    }
+    
+    //one outlier does not kill the batch, it is evaluated like the nearest knot
+    std::vector<std::vector<double>> x = {{0.1, 0.4, 0.8}, {-3.0, 0.4, 7.0}, {0.0, 0.4, 1.0}};
+    std::vector<std::vector<double>> pred = clamped.forward(x, false);
+    for (size_t j = 0; j < 9; j++) {
+        REQUIRE(pred[1][j] == Catch::Approx(pred[2][j]));
+    }
+    REQUIRE_THROWS_AS(reference.forward(x, false), std::runtime_error);
+    
+    //extrapolate on the packed kernel matches the spline by spline evaluation
+    clamped.set_boundary(boundary_policy::extrapolate);
+    std::vector<double> out(9);
+    clamped.forward_into(x[1], out, false);
+    std::vector<std::vector<spline>> splines = clamped.get_splines();
+    for (size_t j = 0; j < 9; j++) {
+        double expected = 0.0;
+        for (size_t i = 0; i < 3; i++) {
+            REQUIRE(splines[i][j].get_boundary() == boundary_policy::extrapolate);
+            expected += splines[i][j].forward(x[1][i]);
+        }
+        REQUIRE(out[j] == Catch::Approx(expected));
+    }
+}
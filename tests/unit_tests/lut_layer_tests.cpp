@@ -0,0 +1,60 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include "../include/SplineNetLib/lut_layer.hpp"
+#include "test_networks.hpp"
+
+using namespace SplineNetLib;
+
+TEST_CASE("lut layer matches the layer within its reported error") {
+    layer l(3, 10, 6, 1.0);
+    l.lr = 0.5;
+    train_a_little(l);
+    REQUIRE_THROWS_AS(lut_layer(l, 1), std::invalid_argument);
+    
+    lut_layer coarse(l, 16), fine(l, 1024), quantized(l, 1024, true);
+    REQUIRE(fine.max_error() < coarse.max_error());
+    REQUIRE(fine.max_error() < 1e-3);
+    REQUIRE(quantized.is_quantized());
+    REQUIRE(quantized.table_bytes() < fine.table_bytes());
+    
+    //max_error is a bound, so no sample (grid points, cell middles or anything between) may be further away
+    for (size_t k = 0; k <= 1000; k++) {
+        double offset = (double)k / 1000.0;
+        std::vector<double> x = {offset, std::fmod(offset + 0.31, 1.0), 1.0 - offset};
+        std::vector<double> expected = l.forward(x, false);
+        for (lut_layer* table : {&coarse, &fine, &quantized}) {
+            std::vector<double> out = table->forward(x, false);
+            for (size_t j = 0; j < 10; j++) {
+                REQUIRE(std::fabs(out[j] - expected[j]) <= table->max_error());
+            }
+        }
+    }
+    
+    //batches give the same result as single samples
+    std::vector<std::vector<double>> batch;
+    for (size_t b = 0; b < 40; b++) {
+        batch.push_back({(double)b / 40.0, (double)(b % 7) / 7.0, 0.5});
+    }
+    std::vector<std::vector<double>> pred = fine.forward(batch, true);
+    for (size_t b = 0; b < batch.size(); b++) {
+        std::vector<double> single = fine.forward(batch[b], true);
+        for (size_t j = 0; j < 10; j++) {
+            REQUIRE(pred[b][j] == single[j]);
+        }
+    }
+    REQUIRE_THROWS_AS(fine.forward({0.5, 0.5, 1.5}, false), std::runtime_error);
+    //x below the range isnt continued with the first cubic like spline::forward does, so it is rejected as well
+    REQUIRE_THROWS_AS(fine.forward({0.5, -0.25, 0.5}, false), std::runtime_error);
+}
+
+TEST_CASE("lut layer uses the boundary policy of its layer") {
+    layer l(2, 4, 6, 1.0, spline_kind::natural, boundary_policy::clamp);
+    l.lr = 0.5;
+    train_a_little(l);
+    lut_layer table(l, 256);
+    std::vector<double> inside = table.forward({0.0, 1.0}, false), outside = table.forward({-2.0, 3.0}, false);
+    for (size_t j = 0; j < 4; j++) {
+        REQUIRE(outside[j] == Catch::Approx(inside[j]));
+    }
+}
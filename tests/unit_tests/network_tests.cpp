@@ -1,10 +1,190 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
 
-#include "catch2/catch.hpp"
-
-#include "../include/SplineNetLib/layers.hpp"
+#include "../include/SplineNetLib/SplineNet.hpp"
+#include "test_networks.hpp"
 
 using namespace SplineNetLib ;
 
 //test initialization
-TEST_CASE("network initialization using constructor method functions as expected") {}
-    
\ No newline at end of file
+TEST_CASE("network initialization using constructor method functions as expected") {
+    nn Test_nn(2, {3, 4}, {4, 2}, {6, 5}, {1.0, 1.0});
+    
+    REQUIRE(Test_nn.layers.size() == 2);
+    REQUIRE(Test_nn.layers[0].input_size() == 3);
+    REQUIRE(Test_nn.layers[1].output_size() == 2);
+}
+
+TEST_CASE("network forward_into matches forward") {
+    nn Test_nn(3, {2, 5, 3}, {5, 3, 2}, {6, 4, 5}, {1.0, 1.0, 1.0});
+    for (auto& l : Test_nn.layers) {
+        l.interpolate_splines();
+    }
+    //train a little so the layers output something other than 0
+    for (int step = 0; step < 3; step++) {
+        std::vector<double> x = {0.2 * step, 0.9 - 0.2 * step};
+        Test_nn.forward(x, true);
+        Test_nn.backward(x, {-1.0, -0.5});
+    }
+    
+    std::vector<double> out(2), workspace(Test_nn.workspace_size());
+    for (std::vector<double> x : {std::vector<double>{0.1, 0.3}, std::vector<double>{0.75, 0.5}}) {
+        std::vector<double> expected = Test_nn.forward(x, true);
+        Test_nn.forward_into(x, out, true);
+        for (size_t j = 0; j < out.size(); j++) {
+            REQUIRE(out[j] == Catch::Approx(expected[j]));
+        }
+        const nn& const_nn = Test_nn;
+        const_nn.forward_into(x, out, true, workspace);
+        for (size_t j = 0; j < out.size(); j++) {
+            REQUIRE(out[j] == Catch::Approx(expected[j]));
+        }
+    }
+    REQUIRE_THROWS(Test_nn.forward_into(std::vector<double>{0.1}, out, true));
+}
+
+TEST_CASE("network batched forward matches the single sample forward") {
+    nn Test_nn(2, {2, 4}, {4, 3}, {6, 5}, {1.0, 1.0});
+    for (auto& l : Test_nn.layers) {
+        l.interpolate_splines();
+        l.grain = 2;
+    }
+    Test_nn.forward(std::vector<double>{0.4, 0.6}, true);
+    Test_nn.backward({0.4, 0.6}, {-1.0, 0.5, 2.0});
+    
+    std::vector<std::vector<double>> x;
+    for (int b = 0; b < 20; b++) {
+        x.push_back({b / 19.0, 1.0 - b / 19.0});
+    }
+    std::vector<std::vector<double>> batch_pred = Test_nn.forward(x, true);
+    REQUIRE(batch_pred.size() == x.size());
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> pred = Test_nn.forward(x[b], true);
+        for (size_t j = 0; j < pred.size(); j++) {
+            REQUIRE(batch_pred[b][j] == Catch::Approx(pred[j]));
+        }
+    }
+}
+
+TEST_CASE("network batched backward matches backpropagating layer by layer") {
+    std::vector<std::vector<double>> x, d_y;
+    for (int b = 0; b < 12; b++) {
+        x.push_back({b / 11.0, 1.0 - b / 11.0});
+        d_y.push_back({(double)(b % 3) - 1.0, 0.5, (double)(b % 4) - 2.0});
+    }
+    
+    //reference: keep every layer input by hand
+    nn reference(4, {2, 4, 5, 3}, {4, 5, 3, 3}, {5, 4, 6, 5}, {1.0, 1.0, 1.0, 1.0});
+    for (auto& l : reference.layers) {
+        l.interpolate_splines();
+    }
+    std::vector<std::vector<std::vector<double>>> inputs = {x};
+    for (size_t i = 0; i + 1 < reference.layers.size(); i++) {
+        inputs.push_back(reference.layers[i].forward(inputs.back(), true));
+    }
+    std::vector<std::vector<double>> expected_grad = d_y;
+    for (size_t i = reference.layers.size(); i-- > 0;) {
+        expected_grad = reference.layers[i].backward(inputs[i], expected_grad);
+    }
+    
+    //no limit (all inputs kept) and budgets that only fit some or only the network input
+    for (size_t budget : {(size_t)0, (size_t)1000, (size_t)1}) {
+        nn Test_nn(4, {2, 4, 5, 3}, {4, 5, 3, 3}, {5, 4, 6, 5}, {1.0, 1.0, 1.0, 1.0});
+        for (auto& l : Test_nn.layers) {
+            l.interpolate_splines();
+        }
+        Test_nn.training = true;
+        Test_nn.activation_budget = budget;
+        Test_nn.forward(x, true);
+        std::vector<std::vector<double>> grad = Test_nn.backward(x, d_y);
+        
+        for (size_t b = 0; b < x.size(); b++) {
+            for (size_t i = 0; i < 2; i++) {
+                REQUIRE(grad[b][i] == Catch::Approx(expected_grad[b][i]));
+            }
+        }
+        for (size_t l = 0; l < Test_nn.layers.size(); l++) {
+            std::vector<std::vector<spline>> expected = reference.layers[l].get_splines(), actual = Test_nn.layers[l].get_splines();
+            for (size_t i = 0; i < expected.size(); i++) {
+                for (size_t j = 0; j < expected[i].size(); j++) {
+                    std::vector<std::vector<double>> e = expected[i][j].get_points(), a = actual[i][j].get_points();
+                    for (size_t k = 0; k < e.size(); k++) {
+                        REQUIRE(a[k][1] == Catch::Approx(e[k][1]));
+                    }
+                }
+            }
+        }
+        //the kept inputs are used up
+        REQUIRE_THROWS(Test_nn.backward(x, d_y));
+    }
+}
+
+TEST_CASE("network fit reduces the loss and stops early") {
+    std::vector<std::vector<double>> x, y;
+    for (int b = 0; b < 40; b++) {
+        double v = b / 39.0;
+        x.push_back({v, 1.0 - v});
+        y.push_back({0.5 * v + 0.2, v * v});
+    }
+    nn Test_nn(2, {2, 4}, {4, 2}, {6, 6}, {1.0, 1.0});
+    for (auto& l : Test_nn.layers) {
+        l.interpolate_splines();
+        l.lr = 0.05;
+    }
+    
+    fit_options options;
+    options.epochs = 30;
+    options.batch_size = 8;
+    size_t callbacks = 0;
+    options.on_epoch = [&](size_t epoch, double) { REQUIRE(epoch == callbacks++); };
+    fit_result result = Test_nn.fit(x, y, options);
+    
+    REQUIRE(result.epoch_loss.size() == 30);
+    REQUIRE(callbacks == 30);
+    REQUIRE_FALSE(result.stopped_early);
+    REQUIRE(result.epoch_loss.back() < result.epoch_loss.front());
+    REQUIRE_FALSE(Test_nn.training);
+    
+    //min_delta larger than any improvement -> stops after patience epochs
+    options.patience = 2;
+    options.min_delta = 1e9;
+    options.on_epoch = nullptr;
+    result = Test_nn.fit(x, y, options);
+    REQUIRE(result.stopped_early);
+    REQUIRE(result.epoch_loss.size() == 3);
+    
+    REQUIRE_THROWS(Test_nn.fit(x, std::vector<std::vector<double>>(3, {0.0, 0.0}), 1, 8));
+}
+
+TEST_CASE("network forward_async matches forward") {
+    nn Test_nn(2, {3, 4}, {4, 2}, {5, 6}, {1.0, 1.0}, spline_kind::natural, boundary_policy::clamp);
+    train_a_little(Test_nn);
+    
+    std::vector<std::vector<double>> x = {{0.1, 0.3, 0.5}, {0.75, 0.5, 0.0}, {1.0, 0.05, 0.9}};
+    std::vector<std::future<std::vector<double>>> single;
+    for (const auto& sample : x) {
+        single.push_back(Test_nn.forward_async(sample, true));
+    }
+    std::future<std::vector<std::vector<double>>> batch = Test_nn.forward_async(x, true);
+    std::vector<std::vector<double>> batch_pred = batch.get();
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> expected = Test_nn.forward(x[b], true), pred = single[b].get();
+        for (size_t j = 0; j < 2; j++) {
+            REQUIRE(pred[j] == Catch::Approx(expected[j]));
+            REQUIRE(batch_pred[b][j] == Catch::Approx(expected[j]));
+        }
+    }
+    
+    //errors end up in the future
+    std::future<std::vector<double>> bad = Test_nn.forward_async(std::vector<double>{0.1}, true);
+    REQUIRE_THROWS_AS(bad.get(), std::invalid_argument);
+    
+    //a throwing callback is dropped instead of terminating the worker thread
+    std::promise<void> called;
+    Test_nn.forward_async(x[0], true, [&called](std::vector<double>, std::exception_ptr) {
+        called.set_value();
+        throw std::runtime_error("callback failed");
+    });
+    called.get_future().wait();
+    REQUIRE(Test_nn.forward_async(x[1], true).get().size() == 2);
+}
@@ -0,0 +1,85 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <cmath>
+
+#include "../include/SplineNetLib/layers.hpp"
+
+using namespace SplineNetLib;
+
+TEST_CASE("optimizer updates match their formulas") {
+    std::vector<double> g = {0.5, -2.0, 0.0, 4.0};
+    
+    SECTION("sgd") {
+        optimizer opt;
+        std::vector<double> y(4, 1.0), grad = g;
+        optimizer_update(opt, 0.1, 0.5, 1, y.data(), grad.data(), (double*)nullptr, (double*)nullptr, 4);
+        for (size_t i = 0; i < 4; i++) {
+            REQUIRE(y[i] == Catch::Approx(1.0 - 0.1 * 0.5 * g[i]));
+            REQUIRE(grad[i] == 0.0);
+        }
+    }
+    SECTION("momentum") {
+        optimizer opt;
+        opt.kind = optimizer_kind::momentum;
+        std::vector<double> y(4, 1.0), m(4, 0.0), grad = g;
+        optimizer_update(opt, 0.1, 1.0, 1, y.data(), grad.data(), m.data(), (double*)nullptr, 4);
+        grad = g;
+        optimizer_update(opt, 0.1, 1.0, 2, y.data(), grad.data(), m.data(), (double*)nullptr, 4);
+        for (size_t i = 0; i < 4; i++) {
+            //steps of g and 1.9 g
+            REQUIRE(y[i] == Catch::Approx(1.0 - 0.1 * g[i] - 0.1 * 1.9 * g[i]));
+        }
+    }
+    SECTION("rmsprop") {
+        optimizer opt;
+        opt.kind = optimizer_kind::rmsprop;
+        opt.beta2 = 0.9;
+        std::vector<double> y(4, 1.0), v(4, 0.0), grad = g;
+        optimizer_update(opt, 0.1, 1.0, 1, y.data(), grad.data(), (double*)nullptr, v.data(), 4);
+        for (size_t i = 0; i < 4; i++) {
+            REQUIRE(v[i] == Catch::Approx(0.1 * g[i] * g[i]));
+            REQUIRE(y[i] == Catch::Approx(1.0 - 0.1 * g[i] / (std::sqrt(0.1 * g[i] * g[i]) + opt.eps)));
+        }
+    }
+    SECTION("adam") {
+        optimizer opt;
+        opt.kind = optimizer_kind::adam;
+        std::vector<double> y(4, 1.0), m(4, 0.0), v(4, 0.0), grad = g;
+        optimizer_update(opt, 0.1, 1.0, 1, y.data(), grad.data(), m.data(), v.data(), 4);
+        //first bias corrected step is lr * sign(g)
+        for (size_t i = 0; i < 4; i++) {
+            double expected = (g[i] > 0) ? 0.9 : (g[i] < 0 ? 1.1 : 1.0);
+            REQUIRE(y[i] == Catch::Approx(expected));
+        }
+    }
+}
+
+TEST_CASE("layer step uses the optimizer") {
+    std::vector<std::vector<double>> x = {{0.1, 0.9}, {0.6, 0.3}};
+    std::vector<std::vector<double>> d_y = {{1.0, -2.0, 0.5}, {0.5, 3.0, -1.0}};
+    
+    layer sgd_layer(2, 3, 5, 1.0), adam_layer(2, 3, 5, 1.0);
+    adam_layer.optimizer.kind = optimizer_kind::adam;
+    for (layer* l : {&sgd_layer, &adam_layer}) {
+        l->interpolate_splines();
+        l->lr = 0.01;
+        l->backward(x, d_y);
+    }
+    //adams first step moves every y with a gradient by lr
+    std::vector<std::vector<spline>> splines = adam_layer.get_splines();
+    for (auto& row : splines) {
+        for (auto& s : row) {
+            for (auto& p : s.get_points()) {
+                REQUIRE((std::abs(p[1]) == Catch::Approx(0.01) || p[1] == 0.0));
+            }
+        }
+    }
+    REQUIRE(splines[0][0].get_points() != sgd_layer.get_splines()[0][0].get_points());
+    
+    //apply=true goes through step for stateful optimizers
+    std::vector<double> before = adam_layer.get_splines()[1][2].get_points()[3];
+    adam_layer.backward(x[1], d_y[1], true);
+    adam_layer.reset_optimizer();
+    REQUIRE(adam_layer.get_splines()[1][2].get_points()[3] != before);
+}
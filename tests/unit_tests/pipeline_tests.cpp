@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <thread>
+
+#include "../include/SplineNetLib/pipeline.hpp"
+#include "test_networks.hpp"
+
+using namespace SplineNetLib;
+
+static std::vector<std::vector<double>> samples(size_t n) {
+    std::vector<std::vector<double>> x;
+    for (size_t b = 0; b < n; b++) {
+        x.push_back({0.01 * (b % 100), 1.0 - 0.007 * (b % 100), 0.5});
+    }
+    return x;
+}
+
+TEST_CASE("spsc queue keeps the order and blocks when full") {
+    spsc_queue<int> queue(3);
+    int value = 0;
+    REQUIRE_FALSE(queue.try_pop(value));
+    std::thread producer([&]() {
+        for (int i = 0; i < 1000; i++) {
+            int v = i;
+            queue.push(v);
+        }
+        queue.close();
+    });
+    std::vector<int> received;
+    while (queue.pop(value)) {
+        received.push_back(value);
+    }
+    producer.join();
+    REQUIRE(received.size() == 1000);
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE(received[i] == i);
+    }
+}
+
+TEST_CASE("pipeline forward matches nn forward in order") {
+    nn network(4, {3, 6, 5, 4}, {6, 5, 4, 2}, {5, 6, 4, 5}, {1.0, 1.0, 1.0, 1.0}, spline_kind::natural, boundary_policy::clamp);
+    train_a_little(network);
+    std::vector<std::vector<double>> x = samples(203);
+    for (size_t num_stages : {0, 1, 2, 3, 10}) {
+        nn_pipeline pipeline(network, true, num_stages, 16, 2);
+        REQUIRE(pipeline.num_stages() == ((num_stages == 0 || num_stages > 4) ? 4 : num_stages));
+        std::vector<std::vector<double>> pred = pipeline.forward(x);
+        REQUIRE(pred.size() == x.size());
+        for (size_t b = 0; b < x.size(); b++) {
+            std::vector<double> expected = network.forward(x[b], true);
+            for (size_t j = 0; j < 2; j++) {
+                REQUIRE(pred[b][j] == Catch::Approx(expected[j]));
+            }
+        }
+    }
+}
+
+TEST_CASE("pipeline push and pop from different threads") {
+    nn network(3, {3, 6, 4}, {6, 4, 2}, {5, 6, 4}, {1.0, 1.0, 1.0}, spline_kind::natural, boundary_policy::clamp);
+    train_a_little(network);
+    nn_pipeline pipeline(network, false, 2, 8, 2);
+    std::vector<std::vector<double>> x = samples(100);
+    std::vector<double> y;
+    REQUIRE_FALSE(pipeline.try_pop(y));
+    
+    std::thread producer([&]() {
+        for (const auto &sample : x) {
+            pipeline.push(sample);
+        }
+        pipeline.flush(); //100 isnt a multiple of 8
+    });
+    std::vector<std::vector<double>> pred;
+    for (size_t b = 0; b < x.size(); b++) {
+        pred.push_back(pipeline.pop());
+    }
+    producer.join();
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> expected = network.forward(x[b], false);
+        for (size_t j = 0; j < 2; j++) {
+            REQUIRE(pred[b][j] == Catch::Approx(expected[j]));
+        }
+    }
+    REQUIRE_THROWS_AS(pipeline.push(std::vector<double>{0.5}), std::invalid_argument);
+}
+
+TEST_CASE("pipeline passes stage exceptions to the caller") {
+    nn network(2, {3, 4}, {4, 2}, {5, 5}, {1.0, 1.0});
+    train_a_little(network);
+    nn_pipeline pipeline(network, true, 2, 4, 2);
+    std::vector<std::vector<double>> x = samples(10);
+    x[5][0] = 2.0; //out of bounds for the first layer
+    REQUIRE_THROWS_AS(pipeline.forward(x), std::runtime_error);
+    
+    x[5][0] = 0.5;
+    REQUIRE(pipeline.forward(x).size() == 10); //still usable after an error
+}
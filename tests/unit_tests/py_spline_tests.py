@@ -1,4 +1,5 @@
 import PySplineNetLib
+import asyncio
 import unittest
 
 class Spline_Test(unittest.TestCase):
@@ -18,6 +19,60 @@ class Spline_Test(unittest.TestCase):
         self.assertListEqual([[0.0, 0.0], [0.5, 0.5], [1.0, 2.0]], A.get_points())
         """
 
+    def test_Spline_f32_Test(self):
+        A = PySplineNetLib.spline_f32([[0,0],[0.5,1],[1,2]],[[0,0,0,0],[0,0,0,0]])
+        A.interpolation()
+        self.assertAlmostEqual(0.5, A.forward(0.25), delta = 0.0001)
+        ys = A.forward_batch([0.0, 0.25, 0.5, 0.75])
+        for y, target in zip(ys, [0.0, 0.5, 1.0, 1.5]):
+            self.assertAlmostEqual(target, y, delta = 0.0001)
+        
+    def test_Layer_f32_Test(self):
+        a = PySplineNetLib.layer(2, 3, 4, 1.0)
+        b = PySplineNetLib.layer_f32(2, 3, 4, 1.0)
+        a.interpolate_splines()
+        b.interpolate_splines()
+        #the points start at 0, train both the same way so the outputs arent all 0
+        a.lr = 1.0
+        b.lr = 1.0
+        for x, d_y in [([0.25, 0.5], [1.0, -0.5, 0.25]), ([0.75, 0.1], [-1.0, 0.5, 0.5])]:
+            a.forward(x, False)
+            b.forward(x, False)
+            a.backward(x, d_y, True)
+            b.backward(x, d_y, True)
+        y_a = a.forward([0.25, 0.5], False)
+        y_b = b.forward([0.25, 0.5], False)
+        self.assertEqual(len(y_a), len(y_b))
+        self.assertGreater(max(abs(y) for y in y_a), 0.1)
+        for y, y_f in zip(y_a, y_b):
+            self.assertAlmostEqual(y, y_f, places = 4)
+
+    def test_nn_fit_Test(self):
+        net = PySplineNetLib.nn(2, [2, 4], [4, 2], [6, 6], [1.0, 1.0])
+        x = [[i / 19.0, 1.0 - i / 19.0] for i in range(20)]
+        y = [[0.5 * v[0] + 0.2, v[0] * v[0]] for v in x]
+        epochs = []
+        result = net.fit(x, y, epochs=5, batch_size=4, on_epoch=lambda epoch, loss: epochs.append(epoch))
+        self.assertEqual(len(result.epoch_loss), 5)
+        self.assertListEqual([0, 1, 2, 3, 4], epochs)
+        self.assertEqual(len(net.forward(x, False)), 20)
+
+    def test_nn_forward_async_Test(self):
+        net = PySplineNetLib.nn(2, [2, 4], [4, 2], [6, 6], [1.0, 1.0])
+        x = [[i / 19.0, 1.0 - i / 19.0] for i in range(20)]
+        net.fit(x, [[0.5 * v[0] + 0.2, v[0] * v[0]] for v in x], epochs=3, batch_size=4)
+        
+        async def run(sample):
+            return await asyncio.wrap_future(net.forward_async(sample, False))
+        
+        for sample in [x[0], x[7], x[19]]:
+            y = asyncio.run(run(sample))
+            for value, target in zip(y, net.forward(sample, False)):
+                self.assertAlmostEqual(target, value, delta = 1e-9)
+        #the exception of the forward comes back through the future
+        with self.assertRaises(ValueError):
+            asyncio.run(run([0.5]))
+
 class CTensor_Test(unittest.TestCase):
     
     def test_CTensor_init_Test(self):
@@ -0,0 +1,140 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include <filesystem>
+#include <cstring>
+#include <fstream>
+
+#include "../include/SplineNetLib/serialization.hpp"
+#include "test_networks.hpp"
+
+using namespace SplineNetLib;
+
+static std::string temp_model(const std::string &name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TEST_CASE("layer save and load roundtrip") {
+    //irregular knots, bspline splines and the clamp policy all have to survive the roundtrip
+    std::vector<std::vector<std::vector<std::vector<double>>>> points(2), params(2);
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            points[i].push_back({{0.0, 0.1 * j}, {0.15 + 0.05 * i, 1.0}, {0.5, -0.5 * j}, {0.8, 2.0}, {1.0, 0.25 * i}});
+            params[i].push_back(std::vector<std::vector<double>>(4, std::vector<double>(4, 0.0)));
+        }
+    }
+    layer l(points, params, spline_kind::bspline, boundary_policy::clamp);
+    l.interpolate_splines();
+    l.backward({0.3, 0.7}, {1.0, -0.5, 0.25});
+    
+    std::string path = temp_model("splinenetlib_layer_test.spnl");
+    save(l, path);
+    layer loaded = load_layer<double>(path);
+    REQUIRE(loaded.input_size() == 2);
+    REQUIRE(loaded.output_size() == 3);
+    REQUIRE(loaded.get_detail() == 3);
+    REQUIRE(loaded.get_kind() == spline_kind::bspline);
+    REQUIRE(loaded.get_boundary() == boundary_policy::clamp);
+    for (std::vector<double> x : {std::vector<double>{0.0, 1.0}, std::vector<double>{0.17, 0.42}, std::vector<double>{-0.5, 2.0}}) {
+        std::vector<double> expected = l.forward(x, false), pred = loaded.forward(x, false);
+        for (size_t j = 0; j < 3; j++) {
+            REQUIRE(pred[j] == expected[j]);
+        }
+    }
+    //a single precision load of a double model has to fail
+    REQUIRE_THROWS_AS(load_layer<float>(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("network save, load and mapped model give the same outputs") {
+    nn network(2, {3, 4}, {4, 2}, {5, 6}, {1.0, 1.0}, spline_kind::natural, boundary_policy::clamp);
+    train_a_little(network);
+    
+    std::string path = temp_model("splinenetlib_nn_test.spnl");
+    save(network, path);
+    nn loaded = load_nn<double>(path);
+    REQUIRE(loaded.layers.size() == 2);
+    REQUIRE_THROWS_AS(load_layer<double>(path), std::runtime_error);
+    
+    mapped_model model(path);
+    REQUIRE(model.num_layers() == 2);
+    REQUIRE(model.input_size() == 3);
+    REQUIRE(model.output_size() == 2);
+    std::vector<std::vector<double>> x = {{0.1, 0.3, 0.5}, {0.75, 0.5, 0.0}, {1.0, 0.05, 0.9}};
+    std::vector<std::vector<double>> batch = model.forward(x, true);
+    for (size_t b = 0; b < x.size(); b++) {
+        std::vector<double> expected = network.forward(x[b], true), pred = loaded.forward(x[b], true), mapped = model.forward(x[b], true);
+        for (size_t j = 0; j < 2; j++) {
+            REQUIRE(pred[j] == Catch::Approx(expected[j]));
+            REQUIRE(mapped[j] == Catch::Approx(expected[j]));
+            REQUIRE(batch[b][j] == Catch::Approx(expected[j]));
+        }
+    }
+    std::vector<double> out(2), workspace(model.workspace_size() - 1);
+    REQUIRE_THROWS_AS(model.forward_into(x[0], out, true, workspace), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("loading something that isnt a model throws") {
+    REQUIRE_THROWS_AS(load_nn<double>(temp_model("splinenetlib_missing.spnl")), std::runtime_error);
+    
+    std::string path = temp_model("splinenetlib_bad.spnl");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "not a spline network, just some text that is longer than the header";
+    }
+    REQUIRE_THROWS_AS(load_nn<double>(path), std::runtime_error);
+    REQUIRE_THROWS_AS(mapped_model(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+//writes a model file with the given layer headers and enough zero bytes behind them for small arrays
+static std::string write_headers(const std::string &name, std::vector<model_layer_header> layers) {
+    std::string path = temp_model(name);
+    model_file_header header = {};
+    std::memcpy(header.magic, "SPNL", 4);
+    header.version = model_format_version;
+    header.scalar_size = sizeof(double);
+    header.num_layers = (uint32_t)layers.size();
+    header.byte_order = 0x01020304;
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(layers.data()), layers.size() * sizeof(model_layer_header));
+    std::vector<char> zeros(4096, 0);
+    out.write(zeros.data(), zeros.size());
+    return path;
+}
+
+TEST_CASE("loading a header with wrapping array sizes throws") {
+    //2^31 * 2^31 splines with 4 points wrap the element counts to 0
+    model_layer_header layer = {};
+    layer.in_size = 1u << 31;
+    layer.out_size = 1u << 31;
+    layer.detail = 2;
+    layer.knot_x = layer.knot_y = layer.coeffs = 128;
+    std::string path = write_headers("splinenetlib_wrap.spnl", {layer});
+    REQUIRE_THROWS_AS(load_nn<double>(path), std::runtime_error);
+    REQUIRE_THROWS_AS(mapped_model(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("loading layers whose sizes dont chain throws") {
+    //layer 0 has 2 outputs but layer 1 expects 3 inputs, all arrays point into the zero bytes behind the headers
+    model_layer_header first = {}, second = {};
+    first.in_size = 1;
+    first.out_size = 2;
+    second.in_size = 3;
+    second.out_size = 1;
+    first.detail = second.detail = 2;
+    first.knot_x = first.knot_y = first.coeffs = 128;
+    second.knot_x = second.knot_y = second.coeffs = 512;
+    std::string path = write_headers("splinenetlib_chain.spnl", {first, second});
+    REQUIRE_THROWS_AS(load_nn<double>(path), std::runtime_error);
+    REQUIRE_THROWS_AS(mapped_model(path), std::runtime_error);
+    
+    second.in_size = 2; //the same file with matching sizes loads
+    std::filesystem::remove(path);
+    path = write_headers("splinenetlib_chain.spnl", {first, second});
+    REQUIRE(mapped_model(path).num_layers() == 2);
+    std::filesystem::remove(path);
+}
@@ -96,3 +96,205 @@ TEST_CASE("spline sampling at x functions as expected"){
     REQUIRE(y_1_0 == Catch::Approx(5.0));
 }
 
+
+TEST_CASE("spline segment lookup matches a linear scan for uniform and irregular knots"){
+    //layer::layer style knots (uniform exept for the wider last segment) and irregular knots
+    std::vector<std::vector<std::vector<double>>> point_sets = {
+        {{0.0,0.0},{0.1,1.0},{0.2,0.5},{0.3,2.0},{0.4,1.0},{0.6,3.0}},
+        {{0.0,0.0},{0.05,1.0},{0.3,0.5},{0.35,2.0},{0.7,1.0},{1.0,3.0}}
+    };
+    
+    for (const auto& points : point_sets) {
+        spline Test_spline(points, std::vector<std::vector<double>>(points.size() - 1, std::vector<double>(4, 0.0)));
+        Test_spline.interpolation();
+        std::vector<std::vector<double>> params = Test_spline.get_params();
+        
+        for (double x = -0.05; x <= points.back()[0]; x += 0.0125) {
+            //reference: first point with x <= x_i like the old linear search
+            size_t i = 1;
+            while (i < points.size() - 1 && x > points[i][0]) {
+                i++;
+            }
+            double dx = x - points[i - 1][0];
+            double expected = params[i - 1][0] + params[i - 1][1] * dx + params[i - 1][2] * dx * dx + params[i - 1][3] * dx * dx * dx;
+            REQUIRE(Test_spline.forward(x) == Catch::Approx(expected).margin(1e-12));
+        }
+        REQUIRE_THROWS_AS(Test_spline.forward(points.back()[0] + 0.01), std::runtime_error);
+    }
+}
+
+TEST_CASE("spline batched forward matches the scalar forward"){
+    std::vector<std::vector<std::vector<double>>> point_sets = {
+        {{0.0,0.0},{0.1,1.0},{0.2,0.5},{0.3,2.0},{0.4,1.0},{0.6,3.0}},
+        {{0.0,0.0},{0.05,1.0},{0.3,0.5},{0.35,2.0},{0.7,1.0},{1.0,3.0}}
+    };
+    
+    for (const auto& points : point_sets) {
+        spline Test_spline(points, std::vector<std::vector<double>>(points.size() - 1, std::vector<double>(4, 0.0)));
+        Test_spline.interpolation();
+        
+        //37 inputs so the vectorized loops also leave a remainder
+        std::vector<double> xs(37), ys(37);
+        for (size_t b = 0; b < xs.size(); b++) {
+            xs[b] = -0.05 + (points.back()[0] + 0.05) * (double)b / (double)(xs.size() - 1);
+        }
+        Test_spline.forward_batch(xs, ys);
+        for (size_t b = 0; b < xs.size(); b++) {
+            REQUIRE(ys[b] == Catch::Approx(Test_spline.forward(xs[b])).margin(1e-12));
+        }
+        
+        xs[20] = points.back()[0] + 0.5;
+        REQUIRE_THROWS_AS(Test_spline.forward_batch(xs, ys), std::runtime_error);
+        REQUIRE_THROWS_AS(Test_spline.forward_batch(xs, std::span<double>(ys).first(3)), std::invalid_argument);
+    }
+}
+
+TEST_CASE("spline factorization is shared between splines with the same knots"){
+    std::vector<std::vector<double>> points_A = {{0.0,0.0},{0.2,1.0},{0.4,2.5},{0.6,2.0},{0.8,2.0},{1.0,0.5}};
+    std::vector<std::vector<double>> points_B = {{0.0,1.0},{0.2,0.0},{0.4,0.5},{0.6,1.0},{0.8,3.0},{1.0,2.5}};
+    std::vector<std::vector<double>> points_C = {{0.0,1.0},{0.1,0.0},{0.4,0.5},{0.6,1.0},{0.8,3.0},{1.0,2.5}};
+    std::vector<std::vector<double>> parameters(5, std::vector<double>(4, 0.0));
+    
+    spline A(points_A, parameters), B(points_B, parameters), C(points_C, parameters), B_own(points_B, parameters);
+    
+    REQUIRE_NOTHROW(B.share_factorization(A.get_factorization()));
+    REQUIRE(B.get_factorization() == A.get_factorization());
+    REQUIRE_THROWS_AS(C.share_factorization(A.get_factorization()), std::invalid_argument);
+    
+    //interpolating with the shared factorization gives the same result as with an own one
+    B.interpolation();
+    B_own.interpolation();
+    std::vector<std::vector<double>> shared_params = B.get_params(), own_params = B_own.get_params();
+    for (size_t i = 0; i < shared_params.size(); i++) {
+        for (size_t k = 0; k < 4; k++) {
+            REQUIRE(shared_params[i][k] == Catch::Approx(own_params[i][k]));
+        }
+    }
+    //natural spline, second derivative is 0 at both ends
+    REQUIRE(shared_params[0][2] == Catch::Approx(0.0).margin(1e-12));
+    double h = 0.2;
+    REQUIRE(2.0 * shared_params[4][2] + 6.0 * shared_params[4][3] * h == Catch::Approx(0.0).margin(1e-9));
+}
+
+TEST_CASE("single precision spline matches the double precision spline"){
+    std::vector<std::vector<std::vector<double>>> point_sets = {
+        {{0.0,0.0},{0.1,1.0},{0.2,0.5},{0.3,2.0},{0.4,1.0},{0.6,3.0}},
+        {{0.0,0.0},{0.05,1.0},{0.3,0.5},{0.35,2.0},{0.7,1.0},{1.0,3.0}}
+    };
+    
+    for (const auto& points : point_sets) {
+        std::vector<std::vector<float>> points_f(points.size(), std::vector<float>(2));
+        for (size_t i = 0; i < points.size(); i++) {
+            points_f[i] = {(float)points[i][0], (float)points[i][1]};
+        }
+        spline Test_spline(points, std::vector<std::vector<double>>(points.size() - 1, std::vector<double>(4, 0.0)));
+        spline_f Test_spline_f(points_f, std::vector<std::vector<float>>(points.size() - 1, std::vector<float>(4, 0.0f)));
+        Test_spline.interpolation();
+        Test_spline_f.interpolation();
+        
+        std::vector<float> xs(37), ys(37);
+        for (size_t b = 0; b < xs.size(); b++) {
+            xs[b] = (float)(0.999 * points.back()[0] * (double)b / (double)(xs.size() - 1));
+        }
+        Test_spline_f.forward_batch(xs, ys);
+        for (size_t b = 0; b < xs.size(); b++) {
+            REQUIRE(ys[b] == Catch::Approx(Test_spline.forward(xs[b])).margin(1e-4));
+            REQUIRE(Test_spline_f.forward(xs[b]) == Catch::Approx(Test_spline.forward(xs[b])).margin(1e-4));
+        }
+    }
+}
+
+TEST_CASE("b-spline evaluates the cubic basis of its control points"){
+    std::vector<std::vector<double>> points = {{0.0, 0.5}, {0.2, 1.0}, {0.4, -0.5}, {0.6, 2.0}, {0.8, 0.0}, {1.0, 1.5}};
+    std::vector<std::vector<double>> parameters(5, std::vector<double>(4, 0.0));
+    spline b_spline(points, parameters, spline_kind::bspline);
+    b_spline.interpolation();
+    REQUIRE(b_spline.get_kind() == spline_kind::bspline);
+    
+    for (double x : {0.0, 0.05, 0.2, 0.33, 0.5, 0.61, 0.79, 0.95, 1.0}) {
+        uint32_t segment;
+        double offset;
+        double y = b_spline.forward_segment(x, segment, offset);
+        uint32_t index[4];
+        double weight[4];
+        REQUIRE(b_spline.grad_targets(segment, offset, index, weight) == 4);
+        double expected = 0.0, weight_sum = 0.0;
+        for (int k = 0; k < 4; k++) {
+            expected += weight[k] * points[index[k]][1];
+            weight_sum += weight[k];
+        }
+        REQUIRE(y == Catch::Approx(expected));
+        REQUIRE(weight_sum == Catch::Approx(1.0));
+    }
+}
+
+TEST_CASE("b-spline gradient step only changes the segments around the updated control points"){
+    std::vector<std::vector<double>> points(12, std::vector<double>(2, 0.0));
+    for (size_t i = 0; i < points.size(); i++) {
+        points[i] = {(double)i / 11.0, std::sin((double)i)};
+    }
+    spline b_spline(points, std::vector<std::vector<double>>(11, std::vector<double>(4, 0.0)), spline_kind::bspline);
+    b_spline.interpolation();
+    std::vector<std::vector<double>> before = b_spline.get_params();
+    
+    b_spline.backward(0.5, 1.0, b_spline.forward(0.5)); //x = 0.5 is in segment 5 -> control points 4..7
+    b_spline.apply_grad(0.1);
+    std::vector<std::vector<double>> after = b_spline.get_params();
+    std::vector<std::vector<double>> changed_points = b_spline.get_points();
+    for (size_t i = 0; i < points.size(); i++) {
+        bool touched = i >= 4 && i <= 7;
+        REQUIRE((changed_points[i][1] != points[i][1]) == touched);
+    }
+    for (size_t s = 0; s < after.size(); s++) {
+        bool touched = s >= 2 && s <= 8;
+        REQUIRE((after[s] != before[s]) == touched);
+    }
+    
+    //the local update gives the same coefficients as recomputing all segments
+    b_spline.interpolation();
+    std::vector<std::vector<double>> full = b_spline.get_params();
+    for (size_t s = 0; s < full.size(); s++) {
+        for (size_t k = 0; k < 4; k++) {
+            REQUIRE(after[s][k] == Catch::Approx(full[s][k]));
+        }
+    }
+}
+
+TEST_CASE("spline boundary policies clamp or extrapolate inputs outside of the knots"){
+    std::vector<std::vector<double>> points = {{0.0, 0.0}, {0.2, 1.0}, {0.4, 2.5}, {0.6, 2.0}, {0.8, 2.0}, {1.0, 0.5}};
+    spline s(points, std::vector<std::vector<double>>(5, std::vector<double>(4, 0.0)));
+    s.interpolation();
+    REQUIRE(s.get_boundary() == boundary_policy::error);
+    REQUIRE_THROWS_AS(s.forward(1.5), std::runtime_error);
+    
+    std::vector<double> xs = {-0.5, -0.1, 0.0, 0.1, 0.3, 0.55, 0.7, 0.9, 1.0, 1.2, 2.0, std::nan(""), 0.45, 0.65, 1.01, -2.0, 0.5};
+    std::vector<double> ys(xs.size());
+    
+    s.set_boundary(boundary_policy::clamp);
+    s.forward_batch(xs.data(), ys.data(), xs.size());
+    for (size_t b = 0; b < xs.size(); b++) {
+        double clamped = std::isnan(xs[b]) ? 0.0 : std::min(1.0, std::max(0.0, xs[b]));
+        REQUIRE(s.forward(xs[b]) == Catch::Approx(s.forward(clamped)));
+        REQUIRE(ys[b] == Catch::Approx(s.forward(clamped)));
+    }
+    
+    s.set_boundary(boundary_policy::extrapolate);
+    s.forward_batch(xs.data(), ys.data(), xs.size());
+    double eps = 1e-6;
+    double slope_low = (s.forward(eps) - s.forward(0.0)) / eps;
+    double slope_high = (s.forward(1.0) - s.forward(1.0 - eps)) / eps;
+    for (size_t b = 0; b < xs.size(); b++) {
+        if (std::isnan(xs[b])) {
+            REQUIRE(std::isnan(ys[b]));
+            continue;
+        }
+        double expected = s.forward(std::min(1.0, std::max(0.0, xs[b])));
+        if (xs[b] < 0.0) {
+            expected += slope_low * xs[b];
+        } else if (xs[b] > 1.0) {
+            expected += slope_high * (xs[b] - 1.0);
+        }
+        REQUIRE(s.forward(xs[b]) == Catch::Approx(expected).epsilon(1e-4));
+        REQUIRE(ys[b] == Catch::Approx(s.forward(xs[b])));
+    }
+}
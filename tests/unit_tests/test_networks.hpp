@@ -0,0 +1,40 @@
+#ifndef TEST_NETWORKS_HPP
+#define TEST_NETWORKS_HPP
+
+#include "../include/SplineNetLib/SplineNet.hpp"
+
+//interpolates all layers and runs a few training steps so the splines output something other than 0
+//(inputs stay inside [0, 1], so it works with every boundary policy)
+inline void train_a_little(SplineNetLib::nn &network) {
+    for (auto &l : network.layers) {
+        l.interpolate_splines();
+    }
+    std::vector<double> x(network.layers.front().input_size()), d_y(network.layers.back().output_size());
+    for (int step = 0; step < 3; step++) {
+        for (size_t i = 0; i < x.size(); i++) {
+            x[i] = 0.1 + 0.25 * ((step + i) % 4);
+        }
+        for (size_t j = 0; j < d_y.size(); j++) {
+            d_y[j] = (j % 2 == 0) ? -1.0 : 0.5;
+        }
+        network.forward(x, true);
+        network.backward(x, d_y);
+    }
+}
+
+//same for a single layer (with the lr of the layer, raise it to get larger outputs)
+inline void train_a_little(SplineNetLib::layer &l) {
+    l.interpolate_splines();
+    std::vector<double> x(l.input_size()), d_y(l.output_size());
+    for (int step = 0; step < 3; step++) {
+        for (size_t i = 0; i < x.size(); i++) {
+            x[i] = 0.1 + 0.25 * ((step + i) % 4);
+        }
+        for (size_t j = 0; j < d_y.size(); j++) {
+            d_y[j] = (j % 2 == 0) ? -1.0 : 0.5;
+        }
+        l.backward(x, d_y);
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "../include/SplineNetLib/thread_pool.hpp"
+
+using namespace SplineNetLib;
+
+TEST_CASE("thread pool parallel_for covers every index once") {
+    thread_pool pool(4);
+    REQUIRE(pool.size() == 4);
+    
+    for (size_t grain : {1, 3, 64, 1000}) {
+        std::vector<std::atomic<int>> hits(1000);
+        std::atomic<size_t> max_chunk{0};
+        pool.parallel_for(hits.size(), grain, [&](size_t begin, size_t end) {
+            //catch assertions arent thread safe, the chunk size is checked on the test thread afterwards
+            size_t seen = max_chunk.load();
+            while (end - begin > seen && !max_chunk.compare_exchange_weak(seen, end - begin)) {
+            }
+            for (size_t i = begin; i < end; i++) {
+                hits[i]++;
+            }
+        });
+        REQUIRE(max_chunk <= grain);
+        for (auto& h : hits) {
+            REQUIRE(h == 1);
+        }
+    }
+}
+
+TEST_CASE("thread pool passes exceptions to the caller") {
+    thread_pool pool(3);
+    REQUIRE_THROWS_AS(pool.parallel_for(100, 10, [](size_t begin, size_t) {
+        if (begin == 50) {
+            throw std::runtime_error("chunk failed");
+        }
+    }), std::runtime_error);
+    
+    std::future<int> result = pool.submit([]() { return 42; });
+    REQUIRE(result.get() == 42);
+    std::future<void> failed = pool.submit([]() { throw std::runtime_error("task failed"); });
+    REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+    
+    //an enqueued task has no future, its exception is dropped and the worker keeps running
+    for (int t = 0; t < 6; t++) {
+        pool.enqueue([]() { throw std::runtime_error("task failed"); });
+    }
+    REQUIRE(pool.submit([]() { return 43; }).get() == 43);
+}
+
+TEST_CASE("thread pool parallel_for can be nested") {
+    thread_pool pool(2);
+    std::atomic<int> count{0};
+    pool.parallel_for(8, 1, [&](size_t, size_t) {
+        pool.parallel_for(8, 1, [&](size_t, size_t) {
+            count++;
+        });
+    });
+    REQUIRE(count == 64);
+}
+
+TEST_CASE("reset_default_pool finishes the queued tasks first") {
+    std::atomic<int> done{0};
+    std::vector<std::future<void>> results;
+    for (int t = 0; t < 16; t++) {
+        //the tasks use default_pool() themselves while the pool drains
+        results.push_back(default_pool().submit([&done]() {
+            default_pool().parallel_for(4, 1, [&done](size_t begin, size_t end) {
+                done += (int)(end - begin);
+            });
+        }));
+    }
+    reset_default_pool();
+    for (std::future<void> &result : results) {
+        REQUIRE(result.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    }
+    REQUIRE(done == 64);
+    //recreated on the next use
+    REQUIRE(default_pool().submit([]() { return 7; }).get() == 7);
+}